@@ -0,0 +1,434 @@
+#include "bench.h"
+
+extern "C"
+{
+#include <malloc.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace bench
+{
+
+namespace
+{
+
+struct entry
+{
+    std::string name;
+    benchmark_function f;
+};
+
+std::vector<entry>& registry()
+{
+    static std::vector<entry> r;
+    return r;
+}
+
+double ns_per_iteration(const sample& s, std::size_t iterations)
+{
+    return s.total_ns / std::max<std::size_t>(iterations, 1);
+}
+
+struct summary
+{
+    double mean = {};
+    double stddev = {};
+    double min = {};
+    double median = {};
+};
+
+summary summarize(std::vector<double> values)
+{
+    summary s;
+    if (values.empty())
+        return s;
+
+    std::sort(values.begin(), values.end());
+    s.min = values.front();
+    s.median = values.size() % 2 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2;
+
+    for (double v : values)
+        s.mean += v;
+    s.mean /= values.size();
+
+    if (values.size() > 1)
+    {
+        for (double v : values)
+            s.stddev += (v - s.mean) * (v - s.mean);
+        s.stddev = std::sqrt(s.stddev / (values.size() - 1));
+    }
+
+    return s;
+}
+
+template <typename Member>
+summary summarize(const phase_result& r, Member member)
+{
+    std::vector<double> values;
+    for (auto&& s : r.samples)
+        values.push_back(member(s));
+    return summarize(std::move(values));
+}
+
+void print_timing(const std::string& desc, std::size_t iterations, std::chrono::nanoseconds elapsed)
+{
+    double total_time = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    if (total_time < 1.0)
+    {
+        total_time = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        std::cout << desc << ": total_time=" << total_time << "us";
+    }
+    else
+    {
+        std::cout << desc << ": total_time=" << total_time << "ms";
+    }
+
+    double per_iteration = elapsed.count() / double(iterations);
+    std::cout << " per_iteration=" << per_iteration << "ns" << std::endl;
+}
+
+std::string json_string(const std::string& s)
+{
+    std::ostringstream os;
+    os << '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':  os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n"; break;
+        case '\t': os << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+            else
+                os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
+void write_summary(std::ostream& os, const char* name, const summary& s)
+{
+    os << json_string(name) << ": {\"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+       << ", \"min\": " << s.min << ", \"median\": " << s.median << "}";
+}
+
+void write_json(std::ostream& os, const char* executable, const options& opts, const std::vector<phase_result>& results)
+{
+    const std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    os << std::setprecision(10);
+    os << "{\n"
+       << "  \"context\": {\"executable\": " << json_string(executable) << ", \"date\": " << json_string(date)
+       << ", \"warmup\": " << opts.warmup << ", \"repetitions\": " << opts.repetitions << "},\n"
+       << "  \"results\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const phase_result& r = results[i];
+
+        os << (i ? "," : "") << "\n    {\n"
+           << "      \"benchmark\": " << json_string(r.benchmark) << ",\n"
+           << "      \"phase\": " << json_string(r.phase) << ",\n"
+           << "      \"iterations\": " << r.iterations << ",\n      ";
+        write_summary(os, "ns_per_iteration", summarize(r, [&](const sample& s) { return ns_per_iteration(s, r.iterations); }));
+        os << ",\n      \"samples\": [";
+
+        for (std::size_t j = 0; j < r.samples.size(); ++j)
+        {
+            const sample& s = r.samples[j];
+            os << (j ? "," : "") << "\n        {\"total_ns\": " << s.total_ns
+               << ", \"ns_per_iteration\": " << ns_per_iteration(s, r.iterations);
+            if (s.has_latencies)
+                os << ", \"min_ns\": " << s.min_ns << ", \"p50_ns\": " << s.p50_ns << ", \"p90_ns\": " << s.p90_ns
+                   << ", \"p99_ns\": " << s.p99_ns << ", \"p999_ns\": " << s.p999_ns << ", \"max_ns\": " << s.max_ns;
+            os << ", \"malloc_calls\": " << s.malloc_calls << ", \"malloc_bytes\": " << s.malloc_bytes;
+            for (auto&& m : s.metrics)
+            {
+                os << ", " << json_string(m.first) << ": ";
+                if (std::isnan(m.second))
+                    os << "null";
+                else
+                    os << m.second;
+            }
+            os << "}";
+        }
+
+        os << "\n      ]\n    }";
+    }
+
+    os << "\n  ]\n}" << std::endl;
+}
+
+// medians over the repetitions, but the time per iteration: mean and relative stddev
+void print_table(std::ostream& os, const std::vector<phase_result>& results)
+{
+    std::size_t width = 10;
+    for (auto&& r : results)
+        width = std::max(width, r.benchmark.size() + r.phase.size() + 3);
+
+    os << std::left << std::setw(width) << "benchmark" << std::right
+       << std::setw(12) << "iterations" << std::setw(12) << "ns/iter" << std::setw(8) << "+-%"
+       << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max"
+       << std::setw(12) << "mallocs" << std::endl;
+
+    for (auto&& r : results)
+    {
+        const summary t = summarize(r, [&](const sample& s) { return ns_per_iteration(s, r.iterations); });
+        const bool latencies = !r.samples.empty() && r.samples.front().has_latencies;
+
+        os << std::left << std::setw(width) << (r.benchmark + " <" + r.phase + ">") << std::right
+           << std::setw(12) << r.iterations
+           << std::setw(12) << std::fixed << std::setprecision(1) << t.mean
+           << std::setw(8) << (t.mean ? 100 * t.stddev / t.mean : 0.0) << std::setprecision(0);
+
+        if (latencies)
+        {
+            os << std::setw(10) << summarize(r, [](const sample& s) { return s.p50_ns; }).median
+               << std::setw(10) << summarize(r, [](const sample& s) { return s.p99_ns; }).median
+               << std::setw(10) << summarize(r, [](const sample& s) { return s.p999_ns; }).median
+               << std::setw(12) << summarize(r, [](const sample& s) { return s.max_ns; }).median;
+        }
+        else
+        {
+            os << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(12) << "-";
+        }
+
+        os << std::setw(12) << summarize(r, [](const sample& s) { return double(s.malloc_calls); }).median
+           << std::defaultfloat << std::setprecision(6);
+
+        if (!r.samples.empty())
+            for (auto&& m : r.samples.front().metrics)
+            {
+                const bool measured = std::none_of(r.samples.begin(), r.samples.end(), [&](const sample& s) { return std::isnan(s.metrics.at(m.first)); });
+                os << "  " << m.first << "=";
+                if (measured)
+                    os << summarize(r, [&](const sample& s) { return s.metrics.at(m.first); }).median;
+                else
+                    os << "n/a";
+            }
+        os << std::endl;
+    }
+}
+
+void usage(const char* argv0)
+{
+    std::cerr << "usage: " << argv0 << " [--list] [--filter <regex>] [--warmup <n>] [--repetitions <n>]"
+              << " [--json <file>] [--size-classes <n>] [--callsites <n>] [--quiet]" << std::endl;
+}
+
+}
+
+void context::end_phase(const std::string& phase, std::size_t iterations, std::chrono::nanoseconds elapsed,
+                        const latency_histogram* latencies, const perf_counters& counters, const tracer& mt)
+{
+    _last_phase = phase;
+    if (!_recording)
+        return;
+
+    auto ns = [](std::uint64_t cycles) { return double(tsc_chrono::from_cycles(cycles).count()); };
+
+    sample s;
+    s.total_ns = elapsed.count();
+    if (latencies)
+    {
+        s.has_latencies = true;
+        s.min_ns = ns(latencies->min());
+        s.p50_ns = ns(latencies->value_at_percentile(50));
+        s.p90_ns = ns(latencies->value_at_percentile(90));
+        s.p99_ns = ns(latencies->value_at_percentile(99));
+        s.p999_ns = ns(latencies->value_at_percentile(99.9));
+        s.max_ns = ns(latencies->max());
+    }
+
+    const malloc_counter allocs = mt.get<0>();
+    s.malloc_calls = allocs.malloc_calls();
+    s.malloc_bytes = allocs.malloc_bytes();
+
+    if (!_options.quiet)
+    {
+        const std::string desc = _benchmark + " <" + phase + ">";
+
+        print_timing(desc, iterations, elapsed);
+        if (latencies)
+            std::cout << desc << ": " << *latencies << std::endl;
+        counters.print(std::cout, desc, iterations);
+        std::cout << desc << ": malloc_calls=" << s.malloc_calls << " bytes_allocated=" << (s.malloc_bytes / std::size_t(1 << 20)) << "M" << std::endl;
+
+        if (_options.size_classes)
+        {
+            std::cout << desc << ": top " << _options.size_classes << " allocation size classes" << std::endl;
+            mt.get<1>().print_top(std::cout, _options.size_classes);
+        }
+
+        if (_options.callsites)
+        {
+            std::cout << desc << ": top " << _options.callsites << " allocation call sites" << std::endl;
+            mt.get<2>().print_top(std::cout, _options.callsites);
+        }
+    }
+
+    auto it = std::find_if(_results.begin(), _results.end(), [&](const phase_result& r)
+    {
+        return r.benchmark == _benchmark && r.phase == phase;
+    });
+
+    if (it == _results.end())
+    {
+        _results.push_back(phase_result{_benchmark, phase, iterations, {}});
+        it = _results.end() - 1;
+    }
+    it->samples.push_back(s);
+}
+
+void context::annotate(const std::string& metric, double value)
+{
+    if (!_recording || _last_phase.empty())
+        return;
+
+    if (!_options.quiet)
+    {
+        std::cout << _benchmark << " <" << _last_phase << ">: " << metric << "=";
+        if (std::isnan(value))
+            std::cout << "n/a" << std::endl;
+        else
+            std::cout << value << std::endl;
+    }
+
+    for (auto&& r : _results)
+        if (r.benchmark == _benchmark && r.phase == _last_phase)
+            r.samples.back().metrics[metric] = value;
+}
+
+std::size_t heap_in_use()
+{
+    const struct mallinfo2 info = ::mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+void add(const std::string& name, benchmark_function f)
+{
+    registry().push_back(entry{name, std::move(f)});
+}
+
+int run(int argc, char** argv)
+{
+    options opts;
+    bool list = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 == argc)
+                throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+
+        try
+        {
+            if (arg == "--list")
+                list = true;
+            else if (arg == "--filter")
+                opts.filter = value();
+            else if (arg == "--warmup")
+                opts.warmup = std::stoul(value());
+            else if (arg == "--repetitions")
+                opts.repetitions = std::stoul(value());
+            else if (arg == "--json")
+                opts.json = value();
+            else if (arg == "--size-classes")
+                opts.size_classes = std::stoul(value());
+            else if (arg == "--callsites")
+                opts.callsites = std::stoul(value());
+            else if (arg == "--quiet")
+                opts.quiet = true;
+            else
+                throw std::invalid_argument("unknown option " + arg);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    const std::regex filter(opts.filter);
+    std::vector<const entry*> selected;
+    for (auto&& e : registry())
+        if (std::regex_search(e.name, filter))
+            selected.push_back(&e);
+
+    if (list)
+    {
+        for (auto&& e : selected)
+            std::cout << e->name << std::endl;
+        return 0;
+    }
+
+    if (selected.empty())
+    {
+        std::cerr << "no benchmark matches " << opts.filter << std::endl;
+        return 1;
+    }
+
+    if (opts.repetitions == 0)
+    {
+        std::cerr << "at least one repetition is needed" << std::endl;
+        return 1;
+    }
+
+    tsc_chrono::init();
+    malloc_sizes::enable(opts.size_classes > 0);
+    malloc_callsites::enable(opts.callsites > 0);
+
+    std::vector<phase_result> results;
+    for (auto&& e : selected)
+    {
+        for (std::size_t i = 0; i < opts.warmup; ++i)
+        {
+            context ctx(e->name, opts, false, results);
+            e->f(ctx);
+        }
+
+        for (std::size_t i = 0; i < opts.repetitions; ++i)
+        {
+            context ctx(e->name, opts, true, results);
+            e->f(ctx);
+        }
+    }
+
+    std::cout << std::endl;
+    print_table(std::cout, results);
+
+    if (!opts.json.empty())
+    {
+        std::ofstream ofs(opts.json);
+        write_json(ofs, argv[0], opts, results);
+        if (!ofs)
+        {
+            std::cerr << "cannot write " << opts.json << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+}
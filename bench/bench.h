@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../mtrace/mtrace.h"
+#include "../mtrace/malloc_counter.h"
+#include "../mtrace/malloc_callsites.h"
+#include "../mtrace/malloc_sizes.h"
+#include "../mtrace/latency_histogram.h"
+#include "../mtrace/perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Benchmarks register themselves as functions of a context, in which they run named phases.
+// bench::run() runs every registered benchmark matching the command line `warmup` times
+// unrecorded, then `repetitions` times; each phase of each repetition gets its time, its
+// latency percentiles, hardware counters and allocations recorded. Results are printed as a
+// table and can be written as JSON for bench_compare.
+namespace bench
+{
+
+struct options
+{
+    std::string filter;             // regex searched in the benchmark names, all when empty
+    std::size_t warmup = 1;
+    std::size_t repetitions = 3;
+    std::string json;               // output file, none when empty
+    std::size_t size_classes = 0;   // top allocation size classes reported per phase
+    std::size_t callsites = 0;      // top allocation call sites reported per phase
+    bool quiet = false;             // only the final table
+};
+
+// one repetition of a phase
+struct sample
+{
+    double total_ns = {};
+    bool has_latencies = false;     // false for batch phases, timed as a whole
+    double min_ns = {};
+    double p50_ns = {};
+    double p90_ns = {};
+    double p99_ns = {};
+    double p999_ns = {};
+    double max_ns = {};
+    std::size_t malloc_calls = {};
+    std::size_t malloc_bytes = {};
+    std::map<std::string, double> metrics; // added by the benchmark with context::annotate()
+};
+
+struct phase_result
+{
+    std::string benchmark;
+    std::string phase;
+    std::size_t iterations = {};
+    std::vector<sample> samples;
+};
+
+class context
+{
+public:
+    using tracer = mtrace<malloc_counter, malloc_sizes, malloc_callsites>;
+
+    context(const std::string& benchmark, const options& opts, bool recording, std::vector<phase_result>& results) :
+        _benchmark(benchmark),
+        _options(opts),
+        _recording(recording),
+        _results(results)
+    {}
+
+    const std::string& name() const { return _benchmark; }
+
+    // every iteration is timed on its own, the cost of the timing is taken out of the total
+    template <typename Callable>
+    void run(const std::string& phase, std::size_t iterations, Callable&& callable)
+    {
+        tracer mt;
+        latency_histogram latencies;
+        perf_counters counters;
+
+        auto start = std::chrono::steady_clock::now();
+        counters.start();
+        const std::chrono::nanoseconds timing = record_latencies(latencies, iterations, callable);
+        counters.stop();
+        auto end = std::chrono::steady_clock::now();
+
+        const std::chrono::nanoseconds elapsed = std::max(std::chrono::nanoseconds(end - start) - timing, std::chrono::nanoseconds(0));
+        end_phase(phase, iterations, elapsed, &latencies, counters, mt);
+    }
+
+    // for operations processing a whole batch in a single call: per iteration is per element
+    template <typename Callable>
+    void run_batch(const std::string& phase, std::size_t elements, Callable&& callable)
+    {
+        tracer mt;
+        perf_counters counters;
+
+        auto start = std::chrono::steady_clock::now();
+        counters.start();
+        callable();
+        counters.stop();
+        auto end = std::chrono::steady_clock::now();
+
+        end_phase(phase, elements, end - start, nullptr, counters, mt);
+    }
+
+    // attaches a value to the last phase run, e.g. a memory footprint; NaN when it could not
+    // be measured, reported as n/a
+    void annotate(const std::string& metric, double value);
+
+private:
+    void end_phase(const std::string& phase, std::size_t iterations, std::chrono::nanoseconds elapsed,
+                   const latency_histogram* latencies, const perf_counters& counters, const tracer& mt);
+
+    std::string _benchmark;
+    const options& _options;
+    bool _recording;
+    std::vector<phase_result>& _results;
+    std::string _last_phase;
+};
+
+// bytes allocated by malloc and still in use, including mmapped blocks
+std::size_t heap_in_use();
+
+using benchmark_function = std::function<void(context&)>;
+
+void add(const std::string& name, benchmark_function f);
+
+// registers a benchmark during static initialization
+struct registrar
+{
+    registrar(const std::string& name, benchmark_function f)
+    {
+        add(name, std::move(f));
+    }
+};
+
+// parses the options, runs the selected benchmarks and reports; returns the exit status
+int run(int argc, char** argv);
+
+}
@@ -0,0 +1,185 @@
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compares two result files written by the benchmarks' --json option: cases are matched by
+// benchmark and phase, and a metric of their samples (ns_per_iteration by default) is
+// compared as the relative delta of the means. The noise is the standard error of that
+// difference, estimated from the spread of the repetitions; a case regresses when its delta
+// is above the threshold and above `sigmas` times the noise, so a single repetition is only
+// judged on the threshold.
+//
+// Exits with 1 when a case regressed, 2 on usage or input errors.
+
+namespace pt = boost::property_tree;
+
+struct stats
+{
+    std::size_t n = {};
+    double mean = {};
+    double stddev = {};
+};
+
+using case_key = std::pair<std::string, std::string>; // benchmark, phase
+
+std::map<case_key, stats> load(const std::string& filename, const std::string& metric)
+{
+    pt::ptree root;
+    pt::read_json(filename, root);
+
+    std::map<case_key, stats> cases;
+    for (auto&& r : root.get_child("results"))
+    {
+        std::vector<double> values;
+        for (auto&& s : r.second.get_child("samples"))
+        {
+            // batch phases have no latencies
+            if (auto v = s.second.get_optional<double>(metric))
+                values.push_back(*v);
+        }
+
+        if (values.empty())
+            continue;
+
+        stats st;
+        st.n = values.size();
+        for (double v : values)
+            st.mean += v;
+        st.mean /= st.n;
+
+        if (st.n > 1)
+        {
+            for (double v : values)
+                st.stddev += (v - st.mean) * (v - st.mean);
+            st.stddev = std::sqrt(st.stddev / (st.n - 1));
+        }
+
+        cases[{r.second.get<std::string>("benchmark"), r.second.get<std::string>("phase")}] = st;
+    }
+
+    return cases;
+}
+
+void usage(const char* argv0)
+{
+    std::cerr << "usage: " << argv0 << " [--metric <sample field>] [--threshold <%>] [--sigmas <n>] <baseline.json> <current.json>" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string metric = "ns_per_iteration";
+    double threshold = 5.0;
+    double sigmas = 2.0;
+    std::vector<std::string> files;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg(argv[i]);
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 == argc)
+                    throw std::invalid_argument(arg + " needs a value");
+                return argv[++i];
+            };
+
+            if (arg == "--metric")
+                metric = value();
+            else if (arg == "--threshold")
+                threshold = std::stod(value());
+            else if (arg == "--sigmas")
+                sigmas = std::stod(value());
+            else if (arg.compare(0, 2, "--") == 0)
+                throw std::invalid_argument("unknown option " + arg);
+            else
+                files.push_back(arg);
+        }
+
+        if (files.size() != 2)
+            throw std::invalid_argument("a baseline and a current result file are needed");
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::map<case_key, stats> baseline, current;
+    try
+    {
+        baseline = load(files[0], metric);
+        current = load(files[1], metric);
+    }
+    catch (const pt::ptree_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    std::size_t width = 10;
+    for (auto&& c : baseline)
+        width = std::max(width, c.first.first.size() + c.first.second.size() + 3);
+
+    std::cout << metric << ", threshold " << threshold << "%, " << sigmas << " sigmas" << std::endl;
+    std::cout << std::left << std::setw(width) << "benchmark" << std::right
+              << std::setw(14) << "baseline" << std::setw(14) << "current"
+              << std::setw(10) << "delta %" << std::setw(10) << "noise %" << std::endl;
+
+    std::size_t regressions = 0, improvements = 0, missing = 0;
+    for (auto&& b : baseline)
+    {
+        const std::string desc = b.first.first + " <" + b.first.second + ">";
+
+        auto it = current.find(b.first);
+        if (it == current.end())
+        {
+            std::cout << std::left << std::setw(width) << desc << std::right << "  only in baseline" << std::endl;
+            ++missing;
+            continue;
+        }
+
+        const stats& base = b.second;
+        const stats& cur = it->second;
+
+        const double delta = base.mean ? 100 * (cur.mean - base.mean) / base.mean : 0.0;
+        const double noise = base.mean ? 100 * std::sqrt(base.stddev * base.stddev / base.n + cur.stddev * cur.stddev / cur.n) / base.mean : 0.0;
+        const bool significant = std::abs(delta) > threshold && std::abs(delta) > sigmas * noise;
+
+        const char* verdict = "";
+        if (significant && delta > 0)
+        {
+            verdict = "  REGRESSION";
+            ++regressions;
+        }
+        else if (significant)
+        {
+            verdict = "  improvement";
+            ++improvements;
+        }
+
+        std::cout << std::left << std::setw(width) << desc << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(14) << base.mean << std::setw(14) << cur.mean
+                  << std::showpos << std::setw(10) << delta << std::noshowpos << std::setw(10) << noise
+                  << std::defaultfloat << std::setprecision(6) << verdict << std::endl;
+    }
+
+    for (auto&& c : current)
+        if (!baseline.count(c.first))
+            std::cout << c.first.first << " <" << c.first.second << ">  only in current" << std::endl;
+
+    std::cout << std::endl << regressions << " regressions, " << improvements << " improvements, "
+              << missing << " missing cases" << std::endl;
+
+    return regressions ? 1 : 0;
+}
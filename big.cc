@@ -1,5 +1,10 @@
-#include "mtrace/mtrace.h"
-#include "mtrace/malloc_counter.h"
+#include "bench/bench.h"
+#include "pool_allocator.h"
+#include "flat_multi_index.h"
+#include "bulk_load.h"
+#include "intrusive_multi_index.h"
+#include "btree_index.h"
+#include "lazy_multi_index.h"
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -9,21 +14,34 @@
 #include <boost/container/flat_set.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <chrono>
 #include <map>
 #include <set>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 using namespace boost::multi_index;
 
 static const std::size_t ContainerSize = std::size_t(1e6);
 
+// bytes of buffer every element owns, 0 with --no-payload to measure the containers alone
+static std::size_t payload_size = 1024;
+
+static std::unique_ptr<char[]> make_payload()
+{
+    return payload_size ? std::make_unique<char[]>(payload_size) : nullptr;
+}
+
 struct A
 {
     explicit A(int _x, int _y) :
-      x(_x), y(_y), buffer(std::make_unique<char[]>(1024))
+      x(_x), y(_y), buffer(make_payload())
     {
     }
 
@@ -48,7 +66,7 @@ struct A
 struct B
 {
     explicit B(int _x, int _y) :
-      x(std::make_unique<int>(_x)), y(std::make_unique<int>(_y)), buffer(std::make_unique<char[]>(1024))
+      x(std::make_unique<int>(_x)), y(std::make_unique<int>(_y)), buffer(make_payload())
     {
     }
 
@@ -69,90 +87,174 @@ struct B
     std::unique_ptr<char[]> buffer;
 };
 
-template <typename Callable>
-void run_benchmark(const std::string& desc, std::size_t iterations, Callable&& callable)
+// keys are drawn in [0, size], so the lookups hit as often whatever the size
+template <typename ContainerT>
+void test_container(bench::context& ctx, std::size_t size)
 {
-    auto start = std::chrono::steady_clock::now();
-
-    for (std::size_t i = 0; i < iterations; ++i)
-        callable();
+    std::random_device rd;
+    auto seed = rd();
 
-    auto end = std::chrono::steady_clock::now();
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> rng(0, int(size));
 
-    double total_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    if (total_time < 1.0)
     {
-        total_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-        std::cout << desc << ": total_time=" << total_time << "us";
+        std::vector<typename ContainerT::value_type> elements;
+        elements.reserve(size);
+        for (std::size_t i = 0; i < size; ++i)
+            elements.emplace_back(rng(gen), rng(gen));
+
+        ContainerT c;
+        ctx.run_batch("bulk load " + std::to_string(size) + " elements",
+                      size,
+                      [&]()
+                      {
+                          bulk_load(c, elements.begin(), elements.end());
+                      });
     }
-    else
+
+    // footprint of a container filled as by the insert phase, on its own and outside of any
+    // phase so that tracing and reporting stay out of it; the idle node pools give their
+    // chunks back first, or the pooled variants would reuse those of the containers before
+    // for free, and the footprint is not available if some pool could not
+    double bytes_per_element = std::numeric_limits<double>::quiet_NaN();
+    if (node_pool_base::release_idle_pools())
     {
-        std::cout << desc << ": total_time=" << total_time << "ms";
+        const std::size_t heap = bench::heap_in_use();
+        ContainerT c;
+        for (std::size_t i = 0; i < size; ++i)
+            c.emplace(rng(gen), rng(gen));
+        // signed, as the heap may as well shrink meanwhile
+        bytes_per_element = double(std::ptrdiff_t(bench::heap_in_use() - heap)) / size;
     }
 
-    double per_iteration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(iterations);
-    std::cout << " per_iteration=" << per_iteration << "ns" << std::endl;
-};
+    ContainerT c;
+    ctx.run("insert " + std::to_string(size) + " elements",
+            size,
+            [&]()
+            {
+                c.emplace(rng(gen), rng(gen));
+            });
+    ctx.annotate("bytes_per_element", bytes_per_element);
 
-template <typename ContainerT>
-void test_container(const std::string& desc)
+    volatile std::size_t x = 0;
+    auto& view = c.template get<0>();
+
+    ctx.run("lookup 100 elements",
+            100,
+            [&]()
+            {
+                auto itt = view.find(rng(gen));
+                x += itt == view.cend();
+            });
+
+    ctx.run("range scan 100 x 100 elements",
+            100,
+            [&]()
+            {
+                auto first = view.lower_bound(rng(gen));
+                for (std::size_t i = 0; i < 100 && first != view.cend(); ++i, ++first)
+                    x += first->get_x();
+            });
+
+    ctx.run("insert 100 elements",
+            100,
+            [&]()
+            {
+                c.emplace(rng(gen), rng(gen));
+            });
+
+    auto it = c.cbegin();
+    ctx.run("container walk",
+            c.size(),
+            [&]()
+            {
+                x += it->get_x();
+                ++it;
+            });
+
+    auto rit = c.crbegin();
+    ctx.run("container reverse_walk",
+            c.size(),
+            [&]()
+            {
+                x += rit->get_x();
+                ++rit;
+            });
+
+    if (c.size() != size + 100)
+        throw std::runtime_error("unexpected container size");
+}
+
+// bulk load timed against the number of threads building the indexes, 1 up to one per index
+template <typename ContainerT, std::size_t Indexes>
+void test_parallel_bulk_load(bench::context& ctx, std::size_t size)
 {
     std::random_device rd;
     auto seed = rd();
 
     std::mt19937 gen(seed);
-    std::uniform_int_distribution<> rng(0, 1e6);
+    std::uniform_int_distribution<> rng(0, int(size));
 
-    mtrace<malloc_counter> mt;
+    for (std::size_t threads = 1; threads <= Indexes; threads *= 2)
+    {
+        std::vector<typename ContainerT::value_type> elements;
+        elements.reserve(size);
+        for (std::size_t i = 0; i < size; ++i)
+            elements.emplace_back(rng(gen), rng(gen));
+
+        ContainerT c;
+        ctx.run_batch("bulk load " + std::to_string(size) + " elements, " + std::to_string(threads) + (threads > 1 ? " threads" : " thread"),
+                      size,
+                      [&]()
+                      {
+                          bulk_load(c, elements.begin(), elements.end(), threads);
+                      });
+
+        if (c.size() != size)
+            throw std::runtime_error("unexpected container size");
+    }
+}
 
-    ContainerT c;
-    run_benchmark(desc + " <insert " + std::to_string(ContainerSize) + " elements>",
-                  ContainerSize,
-                  [&]()
-                  {
-                      c.emplace(rng(gen), rng(gen));
-                  });
+// a secondary index is looked up once every LookupPeriod insertions: eager containers pay
+// for it on every insertion, lazy ones when it is queried
+static const std::size_t LookupPeriod = 1000;
 
-    volatile std::size_t x = 0;
-    auto& view = c.template get<0>();
+template <typename ContainerT, std::size_t Index>
+void test_occasional_lookups(bench::context& ctx, std::size_t size)
+{
+    std::random_device rd;
+    auto seed = rd();
 
-    run_benchmark(desc + " <lookup 100 elements>",
-                  100,
-                  [&]()
-                  {
-                      auto itt = view.find(rng(gen));
-                      x += itt == view.cend();
-                  });
-
-    run_benchmark(desc + " <insert 100 elements>",
-                  100,
-                  [&]()
-                  {
-                      c.emplace(rng(gen), rng(gen));
-                  });
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> rng(0, int(size));
 
-    auto it = c.cbegin();
-    run_benchmark(desc + " <container walk>",
-                  c.size(),
-                  [&]()
-                  {
-                      x += it->get_x();
-                      ++it;
-                  });
+    volatile std::size_t x = 0;
+    std::size_t n = 0;
+    ContainerT c;
 
-    auto rit = c.crbegin();
-    run_benchmark(desc + " <container reverse_walk>",
-                  c.size(),
-                  [&]()
-                  {
-                      x += rit->get_x();
-                      ++rit;
-                  });
-
-    malloc_counter& counter = mt.get<0>();
-    std::cout << "malloc_calls=" << counter.malloc_calls() << " bytes_allocated=" << (counter.malloc_bytes() / std::size_t(1 << 20)) << "M" << std::endl;
-
-    if (c.size() != ContainerSize + 100)
+    ctx.run("insert " + std::to_string(size) + " elements, lookup index " + std::to_string(Index) + " every " + std::to_string(LookupPeriod),
+            size,
+            [&]()
+            {
+                if (++n % LookupPeriod == 0)
+                {
+                    auto& view = c.template get<Index>();
+                    x += view.find(rng(gen)) == view.cend();
+                }
+                else
+                    c.emplace(rng(gen), rng(gen));
+            });
+
+    auto& view = c.template get<Index>();
+    ctx.run("lookup 100 elements on index " + std::to_string(Index),
+            100,
+            [&]()
+            {
+                auto itt = view.find(rng(gen));
+                x += itt == view.cend();
+            });
+
+    if (c.size() != size - size / LookupPeriod)
         throw std::runtime_error("unexpected container size");
 }
 
@@ -165,11 +267,22 @@ struct vector : public std::vector<T>
         this->emplace_back(std::forward<Args>(args)...);
     }
 
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        this->insert(this->end(), std::make_move_iterator(first), std::make_move_iterator(last));
+    }
+
     auto find(int i)
     {
         return std::lower_bound(this->cbegin(), this->cend(), T(i, i));
     }
 
+    auto lower_bound(int i)
+    {
+        return find(i);
+    }
+
     template <std::size_t N>
     auto& get()
     {
@@ -182,8 +295,9 @@ struct vector : public std::vector<T>
     }
 };
 
+// equivalent keys are kept, as in the other containers and the size check
 template <typename T>
-struct flat_set : public boost::container::flat_set<T>
+struct flat_multiset : public boost::container::flat_multiset<T>
 {
     template <std::size_t N>
     auto& get()
@@ -193,13 +307,26 @@ struct flat_set : public boost::container::flat_set<T>
 
     auto find(int i)
     {
-        return boost::container::flat_set<T>::find(A(i, i));
+        return boost::container::flat_multiset<T>::find(A(i, i));
+    }
+
+    auto lower_bound(int i)
+    {
+        return boost::container::flat_multiset<T>::lower_bound(A(i, i));
+    }
+
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        this->insert(std::make_move_iterator(first), std::make_move_iterator(last));
     }
 };
 
-template <typename T>
-struct multiset : public std::multiset<T>
+template <typename T, typename Allocator = std::allocator<T>>
+struct multiset : public std::multiset<T, std::less<T>, Allocator>
 {
+    using base = std::multiset<T, std::less<T>, Allocator>;
+
     template <std::size_t N>
     auto& get()
     {
@@ -208,174 +335,417 @@ struct multiset : public std::multiset<T>
 
     auto find(int i)
     {
-        return std::multiset<T>::find(A(i, i));
+        return base::find(A(i, i));
+    }
+
+    auto lower_bound(int i)
+    {
+        return base::lower_bound(A(i, i));
+    }
+
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        std::stable_sort(first, last);
+        for (; first != last; ++first)
+            this->emplace_hint(this->end(), std::move(*first));
+    }
+};
+
+template <typename Allocator = std::allocator<A>>
+using MIC1Index = boost::multi_index_container<
+    A,
+    indexed_by<
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >
+    >,
+    Allocator
+>;
+
+template <typename Allocator = std::allocator<A>>
+using MIC2Indexes = boost::multi_index_container<
+    A,
+    indexed_by<
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >
+    >,
+    Allocator
+>;
+
+template <typename Allocator = std::allocator<A>>
+using MIC4Indexes = boost::multi_index_container<
+    A,
+    indexed_by<
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >
+    >,
+    Allocator
+>;
+
+template <typename Allocator = std::allocator<A>>
+using MIC8Indexes = boost::multi_index_container<
+    A,
+    indexed_by<
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >
+    >,
+    Allocator
+>;
+
+template <typename Allocator = std::allocator<A>>
+using MIC16Indexes = boost::multi_index_container<
+    A,
+    indexed_by<
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::x>,
+        std::greater<int>
+    >,
+    ordered_non_unique<
+        member<A, int, &A::y>,
+        std::greater<int>
+    >
+    >,
+    Allocator
+>;
+
+using Flat1Index = flat_multi_index<
+    A,
+    flat_ordered<member<A, int, &A::x>>
+>;
+
+using Flat2Indexes = flat_multi_index<
+    A,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>
+>;
+
+using Flat4Indexes = flat_multi_index<
+    A,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>
+>;
+
+using Flat8Indexes = flat_multi_index<
+    A,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>
+>;
+
+using Flat16Indexes = flat_multi_index<
+    A,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::x>>,
+    flat_ordered<member<A, int, &A::y>>,
+    flat_ordered<member<A, int, &A::x>, std::greater<int>>,
+    flat_ordered<member<A, int, &A::y>, std::greater<int>>
+>;
+
+// the reload route of the boost::mic configurations, see bulk_load.h
+static_assert(std::is_same<flat_multi_index_for<MIC4Indexes<>>, Flat4Indexes>::value, "Flat4Indexes is the reload route of MIC4Indexes");
+static_assert(std::is_same<flat_multi_index_for<MIC8Indexes<>>, Flat8Indexes>::value, "Flat8Indexes is the reload route of MIC8Indexes");
+static_assert(std::is_same<flat_multi_index_for<MIC16Indexes<>>, Flat16Indexes>::value, "Flat16Indexes is the reload route of MIC16Indexes");
+
+// a single index container, it does not go inside indexed_by<> with other indexes; get<N>()
+// is only there for test_container, any N is the one ordering, so these variants compare
+// the lookups and scans of a first index, not a replacement for a container's indexes
+template <std::size_t NodeBytes, typename Compare = std::less<int>>
+struct btree : public btree_index<A, member<A, int, &A::x>, Compare, NodeBytes>
+{
+    template <std::size_t N>
+    auto& get()
+    {
+        return *this;
     }
 };
 
+// one tag per index hook
+template <int N>
+struct hook {};
+
+using Intrusive1Index = pooled_multi_index<
+    intrusive_hooked<A, hook<0>>,
+    intrusive_ordered<hook<0>, member<A, int, &A::x>>
+>;
+
+using Intrusive2Indexes = pooled_multi_index<
+    intrusive_hooked<A, hook<0>, hook<1>>,
+    intrusive_ordered<hook<0>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<1>, member<A, int, &A::y>>
+>;
+
+using Intrusive4Indexes = pooled_multi_index<
+    intrusive_hooked<A, hook<0>, hook<1>, hook<2>, hook<3>>,
+    intrusive_ordered<hook<0>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<1>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<2>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<3>, member<A, int, &A::y>, std::greater<int>>
+>;
+
+using Intrusive8Indexes = pooled_multi_index<
+    intrusive_hooked<A, hook<0>, hook<1>, hook<2>, hook<3>, hook<4>, hook<5>, hook<6>, hook<7>>,
+    intrusive_ordered<hook<0>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<1>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<2>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<3>, member<A, int, &A::y>, std::greater<int>>,
+    intrusive_ordered<hook<4>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<5>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<6>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<7>, member<A, int, &A::y>, std::greater<int>>
+>;
+
+using Intrusive16Indexes = pooled_multi_index<
+    intrusive_hooked<A, hook<0>, hook<1>, hook<2>, hook<3>, hook<4>, hook<5>, hook<6>, hook<7>, hook<8>, hook<9>, hook<10>, hook<11>, hook<12>, hook<13>, hook<14>, hook<15>>,
+    intrusive_ordered<hook<0>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<1>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<2>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<3>, member<A, int, &A::y>, std::greater<int>>,
+    intrusive_ordered<hook<4>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<5>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<6>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<7>, member<A, int, &A::y>, std::greater<int>>,
+    intrusive_ordered<hook<8>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<9>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<10>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<11>, member<A, int, &A::y>, std::greater<int>>,
+    intrusive_ordered<hook<12>, member<A, int, &A::x>>,
+    intrusive_ordered<hook<13>, member<A, int, &A::y>>,
+    intrusive_ordered<hook<14>, member<A, int, &A::x>, std::greater<int>>,
+    intrusive_ordered<hook<15>, member<A, int, &A::y>, std::greater<int>>
+>;
+
+// the first index kept by the container, the others caught up on their first lookup
+using Lazy4Indexes = lazy_multi_index<
+    MIC1Index<>,
+    lazy_ordered<member<A, int, &A::y>>,
+    lazy_ordered<member<A, int, &A::x>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::y>, std::greater<int>>
+>;
+
+using Lazy16Indexes = lazy_multi_index<
+    MIC1Index<>,
+    lazy_ordered<member<A, int, &A::y>>,
+    lazy_ordered<member<A, int, &A::x>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::y>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::x>>,
+    lazy_ordered<member<A, int, &A::y>>,
+    lazy_ordered<member<A, int, &A::x>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::y>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::x>>,
+    lazy_ordered<member<A, int, &A::y>>,
+    lazy_ordered<member<A, int, &A::x>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::y>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::x>>,
+    lazy_ordered<member<A, int, &A::y>>,
+    lazy_ordered<member<A, int, &A::x>, std::greater<int>>,
+    lazy_ordered<member<A, int, &A::y>, std::greater<int>>
+>;
+
+struct variant
+{
+    const char* name;
+    void (*f)(bench::context&, std::size_t);
+};
+
+static const variant variants[] = {
+    {"boost::mic 1 index", test_container<MIC1Index<>>},
+    {"boost::mic 2 indexes", test_container<MIC2Indexes<>>},
+    {"boost::mic 4 indexes", test_container<MIC4Indexes<>>},
+    {"boost::mic 8 indexes", test_container<MIC8Indexes<>>},
+    {"boost::mic 16 indexes", test_container<MIC16Indexes<>>},
+    {"std::vector<A>", test_container<vector<A>>},
+    {"std::vector<B>", test_container<vector<B>>},
+    {"std::multiset", test_container<multiset<A>>},
+    {"boost.flat_multiset", test_container<flat_multiset<A>>},
+    {"flat_multi_index 1 index", test_container<Flat1Index>},
+    {"flat_multi_index 2 indexes", test_container<Flat2Indexes>},
+    {"flat_multi_index 4 indexes", test_container<Flat4Indexes>},
+    {"flat_multi_index 8 indexes", test_container<Flat8Indexes>},
+    {"flat_multi_index 16 indexes", test_container<Flat16Indexes>},
+    {"intrusive 1 index", test_container<Intrusive1Index>},
+    {"intrusive 2 indexes", test_container<Intrusive2Indexes>},
+    {"intrusive 4 indexes", test_container<Intrusive4Indexes>},
+    {"intrusive 8 indexes", test_container<Intrusive8Indexes>},
+    {"intrusive 16 indexes", test_container<Intrusive16Indexes>},
+    {"btree 256B nodes", test_container<btree<256>>},
+    {"btree 4KB nodes", test_container<btree<4096>>},
+    {"btree 256B nodes <std::greater>", test_container<btree<256, std::greater<int>>>},
+    {"lazy 4 indexes", test_container<Lazy4Indexes>},
+    {"lazy 16 indexes", test_container<Lazy16Indexes>},
+
+    // heavy inserts, occasional secondary lookups
+    {"boost::mic 4 indexes <occasional lookups>", test_occasional_lookups<MIC4Indexes<>, 3>},
+    {"boost::mic 16 indexes <occasional lookups>", test_occasional_lookups<MIC16Indexes<>, 15>},
+    {"lazy 4 indexes <occasional lookups>", test_occasional_lookups<Lazy4Indexes, 3>},
+    {"lazy 16 indexes <occasional lookups>", test_occasional_lookups<Lazy16Indexes, 15>},
+
+    // indexes built side by side; boost::mic links its indexes together, see its bulk load phase
+    {"flat_multi_index 4 indexes <parallel bulk load>", test_parallel_bulk_load<Flat4Indexes, 4>},
+    {"flat_multi_index 8 indexes <parallel bulk load>", test_parallel_bulk_load<Flat8Indexes, 8>},
+    {"flat_multi_index 16 indexes <parallel bulk load>", test_parallel_bulk_load<Flat16Indexes, 16>},
+    {"intrusive 4 indexes <parallel bulk load>", test_parallel_bulk_load<Intrusive4Indexes, 4>},
+    {"intrusive 8 indexes <parallel bulk load>", test_parallel_bulk_load<Intrusive8Indexes, 8>},
+    {"intrusive 16 indexes <parallel bulk load>", test_parallel_bulk_load<Intrusive16Indexes, 16>},
+
+    // node-based containers only
+    {"boost::mic 1 index <pool_allocator>", test_container<MIC1Index<pool_allocator<A>>>},
+    {"boost::mic 2 indexes <pool_allocator>", test_container<MIC2Indexes<pool_allocator<A>>>},
+    {"boost::mic 4 indexes <pool_allocator>", test_container<MIC4Indexes<pool_allocator<A>>>},
+    {"boost::mic 8 indexes <pool_allocator>", test_container<MIC8Indexes<pool_allocator<A>>>},
+    {"boost::mic 16 indexes <pool_allocator>", test_container<MIC16Indexes<pool_allocator<A>>>},
+    {"std::multiset <pool_allocator>", test_container<multiset<A, pool_allocator<A>>>},
+};
+
+// 1e3, 3162, 1e4, ... up to max: two steps per decade, enough to see each cache level go
+static std::vector<std::size_t> sweep_sizes(std::size_t max)
+{
+    std::vector<std::size_t> sizes;
+    for (double size = 1e3; size <= double(max) * 1.0001; size *= std::sqrt(10.0))
+        sizes.push_back(std::size_t(std::llround(size)));
+    return sizes;
+}
+
+// on top of bench::run's options:
+//   --sweep <max elements>  every container from 1e3 elements up to max instead of 1e6 only
+//   --no-payload            elements without their 1KB buffer
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    std::size_t sweep = 0;
+    std::vector<char*> args;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "--sweep" && i + 1 < argc)
+            sweep = std::size_t(std::stod(argv[++i]));
+        else if (arg == "--no-payload")
+            payload_size = 0;
+        else
+            args.push_back(argv[i]);
+    }
+
+    const std::string suffix = payload_size ? "" : " <no payload>";
+    for (auto&& v : variants)
     {
-        std::cerr << "usage: " << argv[0] << " <0..9>" << std::endl;
-        return 1;
+        auto f = v.f;
+        if (!sweep)
+        {
+            bench::add(v.name + suffix, [f](bench::context& ctx) { f(ctx, ContainerSize); });
+            continue;
+        }
+
+        for (std::size_t size : sweep_sizes(sweep))
+            bench::add(v.name + suffix + " n=" + std::to_string(size), [f, size](bench::context& ctx) { f(ctx, size); });
     }
 
-    using MIC1Index = boost::multi_index_container<
-        A,
-        indexed_by<
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >
-        >
-    >;
-
-    using MIC2Indexes = boost::multi_index_container<
-        A,
-        indexed_by<
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >
-        >
-    >;
-
-    using MIC4Indexes = boost::multi_index_container<
-        A,
-        indexed_by<
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >
-        >
-    >;
-
-    using MIC8Indexes = boost::multi_index_container<
-        A,
-        indexed_by<
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >
-        >
-    >;
-
-    using MIC16Indexes = boost::multi_index_container<
-        A,
-        indexed_by<
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::x>,
-            std::greater<int>
-        >,
-        ordered_non_unique<
-            member<A, int, &A::y>,
-            std::greater<int>
-        >
-        >
-    >;
-
-    const std::string argv0(argv[1]);
-    if (argv0 == "1")
-        test_container<MIC1Index>("boost::mic 1 index");
-    else if (argv0 == "2")
-        test_container<MIC2Indexes>("boost::mic 2 indexes");
-    else if (argv0 == "3")
-        test_container<MIC4Indexes>("boost::mic 4 indexes");
-    else if (argv0 == "4")
-        test_container<MIC8Indexes>("boost::mic 8 indexes");
-    else if (argv0 == "5")
-        test_container<MIC16Indexes>("boost::mic 16 indexes");
-    else if (argv0 == "6")
-        test_container<vector<A>>("std::vector<A>");
-    else if (argv0 == "7")
-        test_container<vector<B>>("std::vector<B>");
-    else if (argv0 == "8")
-        test_container<multiset<A>>("std::multiset");
-    else if (argv0 == "9")
-        test_container<flat_set<A>>("boost.flat_set");
-
-    return 0;
+    return bench::run(int(args.size()), args.data());
 }
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// B+tree ordered container, with the lookups of an ordered_non_unique index: nodes of about
+// NodeBytes, aligned on cache lines, keep their keys contiguous, so a lookup costs a few misses per level instead
+// of one per level of a red-black tree, and with 4KB nodes about one TLB entry per level.
+// Values live in the leaves next to their keys, leaves are linked for ordered iteration.
+//
+// Equivalent keys keep their insertion order, as in ordered_non_unique. Inserting moves
+// values around within a leaf and splits, so iterators are invalidated by insertions, and
+// the key type must be default constructible. There is no erase yet.
+//
+// It is not a drop-in replacement for an ordered_non_unique index. This is a container of
+// its own with a single ordering, not an index specifier: it cannot go inside indexed_by<>
+// next to the other indexes of a multi_index_container, so there is no get<N>() to reach
+// it through, and its iterators do not survive insertions as those of an index do.
+
+namespace detail
+{
+
+// slots of per_slot bytes left in a node once `used` bytes are taken, at least 4
+constexpr std::size_t btree_slots(std::size_t node_bytes, std::size_t used, std::size_t per_slot)
+{
+    return std::max<std::size_t>(4, (node_bytes > used ? node_bytes - used : 0) / per_slot);
+}
+
+}
+
+template <typename Value,
+          typename KeyFromValue,
+          typename Compare = std::less<typename KeyFromValue::result_type>,
+          std::size_t NodeBytes = 256>
+class btree_index
+{
+public:
+    using value_type = Value;
+    using key_from_value = KeyFromValue;
+    using key_compare = Compare;
+    using key_type = typename std::decay<typename KeyFromValue::result_type>::type;
+    using size_type = std::size_t;
+
+    static const std::size_t CacheLine = 64;
+
+private:
+    static const std::size_t MaxHeight = 32;
+
+    struct node
+    {
+        std::uint32_t count = {};
+        bool leaf = {};
+    };
+
+public:
+    static const std::size_t LeafSlots = detail::btree_slots(NodeBytes, sizeof(node) + 2 * sizeof(void*), sizeof(key_type) + sizeof(Value));
+    static const std::size_t InnerSlots = detail::btree_slots(NodeBytes, sizeof(node) + 2 * sizeof(void*) + sizeof(key_type), sizeof(key_type) + sizeof(void*));
+
+private:
+    struct leaf_node : node
+    {
+        leaf_node() { this->leaf = true; }
+
+        Value& value(std::size_t i) { return *reinterpret_cast<Value*>(&values[i]); }
+
+        leaf_node* prev = {};
+        leaf_node* next = {};
+        key_type keys[LeafSlots];
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type values[LeafSlots];
+    };
+
+    // one spare slot, so that a full node takes the insertion and splits after
+    struct inner_node : node
+    {
+        key_type keys[InnerSlots + 1];
+        node* children[InnerSlots + 2];
+    };
+
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        const_iterator() =default;
+
+        reference operator*() const { return _leaf->value(_slot); }
+        pointer operator->() const { return &_leaf->value(_slot); }
+
+        const_iterator& operator++()
+        {
+            if (++_slot == _leaf->count && _leaf->next)
+            {
+                _leaf = _leaf->next;
+                _slot = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        const_iterator& operator--()
+        {
+            if (_slot == 0)
+            {
+                _leaf = _leaf->prev;
+                _slot = _leaf->count;
+            }
+            --_slot;
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        bool operator==(const const_iterator& rhs) const { return _leaf == rhs._leaf && _slot == rhs._slot; }
+        bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class btree_index;
+
+        const_iterator(leaf_node* leaf, std::size_t slot) :
+            _leaf(leaf), _slot(slot)
+        {}
+
+        leaf_node* _leaf = {};
+        std::size_t _slot = {};
+    };
+
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    btree_index()
+    {
+        _root = _first = _last = allocate<leaf_node>();
+    }
+
+    ~btree_index()
+    {
+        destroy(_root, _height);
+    }
+
+    btree_index(const btree_index&) =delete;
+    btree_index& operator=(const btree_index&) =delete;
+
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    std::size_t height() const { return _height + 1; }
+
+    const_iterator begin() const { return const_iterator(_first, 0); }
+    const_iterator end() const { return const_iterator(_last, _last->count); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const { return rbegin(); }
+    const_reverse_iterator crend() const { return rend(); }
+
+    const_iterator lower_bound(const key_type& k) const
+    {
+        return search(k, [&](const key_type* first, const key_type* last) { return std::lower_bound(first, last, k, _comp); });
+    }
+
+    const_iterator upper_bound(const key_type& k) const
+    {
+        return search(k, [&](const key_type* first, const key_type* last) { return std::upper_bound(first, last, k, _comp); });
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const key_type& k) const
+    {
+        return {lower_bound(k), upper_bound(k)};
+    }
+
+    const_iterator find(const key_type& k) const
+    {
+        const_iterator it = lower_bound(k);
+        if (it == end() || _comp(k, it._leaf->keys[it._slot]))
+            return end();
+        return it;
+    }
+
+    std::size_t count(const key_type& k) const
+    {
+        auto range = equal_range(k);
+        return std::distance(range.first, range.second);
+    }
+
+    template <typename... Args>
+    const_iterator emplace(Args&&... args)
+    {
+        return insert(Value(std::forward<Args>(args)...));
+    }
+
+    // after the last element of equivalent key
+    const_iterator insert(Value&& v)
+    {
+        const key_type k = _key(v);
+
+        inner_node* path[MaxHeight];
+        std::size_t positions[MaxHeight];
+
+        node* n = _root;
+        for (std::size_t level = 0; level < _height; ++level)
+        {
+            inner_node* inner = static_cast<inner_node*>(n);
+            path[level] = inner;
+            positions[level] = std::upper_bound(inner->keys, inner->keys + inner->count, k, _comp) - inner->keys;
+            n = inner->children[positions[level]];
+        }
+
+        leaf_node* leaf = static_cast<leaf_node*>(n);
+        std::size_t pos = std::upper_bound(leaf->keys, leaf->keys + leaf->count, k, _comp) - leaf->keys;
+
+        if (leaf->count == LeafSlots)
+        {
+            leaf_node* right = split(leaf);
+            insert_separator(path, positions, right->keys[0], right);
+
+            if (pos > leaf->count)
+            {
+                pos -= leaf->count;
+                leaf = right;
+            }
+        }
+
+        insert_in_leaf(leaf, pos, k, std::move(v));
+        ++_size;
+        return const_iterator(leaf, pos);
+    }
+
+    // into an empty tree: sorts [first, last), fills the leaves and builds the levels above
+    // bottom up; otherwise inserts one by one. Elements are moved out of the range.
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        if (!empty())
+        {
+            for (; first != last; ++first)
+                insert(std::move(*first));
+            return;
+        }
+
+        std::stable_sort(first, last, [&](const Value& lhs, const Value& rhs) { return _comp(_key(lhs), _key(rhs)); });
+
+        std::vector<std::pair<key_type, node*>> level;
+        leaf_node* leaf = _first;
+        level.emplace_back(key_type(), leaf);
+
+        for (; first != last; ++first)
+        {
+            if (leaf->count == LeafSlots)
+            {
+                leaf_node* next = allocate<leaf_node>();
+                leaf->next = next;
+                next->prev = leaf;
+                leaf = next;
+                level.emplace_back(_key(*first), leaf);
+            }
+
+            insert_in_leaf(leaf, leaf->count, _key(*first), std::move(*first));
+            ++_size;
+        }
+        _last = leaf;
+
+        // spread the children evenly, the last inner node of a level is not left with one
+        while (level.size() > 1)
+        {
+            const std::size_t nodes = (level.size() + InnerSlots) / (InnerSlots + 1);
+            std::vector<std::pair<key_type, node*>> above;
+
+            auto child = level.begin();
+            for (std::size_t i = 0; i < nodes; ++i)
+            {
+                const std::size_t children = level.size() / nodes + (i < level.size() % nodes ? 1 : 0);
+                inner_node* inner = allocate<inner_node>();
+                above.emplace_back(child->first, inner);
+
+                inner->children[0] = child->second;
+                ++child;
+                for (std::size_t c = 1; c < children; ++c, ++child)
+                {
+                    inner->keys[c - 1] = child->first;
+                    inner->children[c] = child->second;
+                }
+                inner->count = std::uint32_t(children - 1);
+            }
+
+            level.swap(above);
+            ++_height;
+        }
+        _root = level.front().second;
+    }
+
+    void clear()
+    {
+        destroy(_root, _height);
+        _height = 0;
+        _size = 0;
+        _root = _first = _last = allocate<leaf_node>();
+    }
+
+    key_from_value key_extractor() const { return _key; }
+    key_compare key_comp() const { return _comp; }
+
+private:
+    template <typename Node>
+    static Node* allocate()
+    {
+        const std::size_t bytes = (sizeof(Node) + CacheLine - 1) / CacheLine * CacheLine;
+        void* p = ::aligned_alloc(CacheLine, bytes);
+        if (!p)
+            throw std::bad_alloc();
+        return new (p) Node;
+    }
+
+    static void destroy(node* n, std::size_t height)
+    {
+        if (height == 0)
+        {
+            leaf_node* leaf = static_cast<leaf_node*>(n);
+            for (std::size_t i = 0; i < leaf->count; ++i)
+                leaf->value(i).~Value();
+            leaf->~leaf_node();
+        }
+        else
+        {
+            inner_node* inner = static_cast<inner_node*>(n);
+            for (std::size_t i = 0; i <= inner->count; ++i)
+                destroy(inner->children[i], height - 1);
+            inner->~inner_node();
+        }
+
+        std::free(n);
+    }
+
+    // descends with position(first, last) applied to the keys of each node
+    template <typename Position>
+    const_iterator search(const key_type&, Position position) const
+    {
+        node* n = _root;
+        for (std::size_t level = 0; level < _height; ++level)
+        {
+            inner_node* inner = static_cast<inner_node*>(n);
+            n = inner->children[position(inner->keys, inner->keys + inner->count) - inner->keys];
+        }
+
+        // past the last key of a leaf is the first one of the next
+        leaf_node* leaf = static_cast<leaf_node*>(n);
+        const std::size_t pos = position(leaf->keys, leaf->keys + leaf->count) - leaf->keys;
+        if (pos == leaf->count && leaf->next)
+            return const_iterator(leaf->next, 0);
+        return const_iterator(leaf, pos);
+    }
+
+    static void insert_in_leaf(leaf_node* leaf, std::size_t pos, const key_type& k, Value&& v)
+    {
+        if (pos == leaf->count)
+        {
+            new (&leaf->values[pos]) Value(std::move(v));
+        }
+        else
+        {
+            new (&leaf->values[leaf->count]) Value(std::move(leaf->value(leaf->count - 1)));
+            for (std::size_t i = leaf->count - 1; i > pos; --i)
+                leaf->value(i) = std::move(leaf->value(i - 1));
+            leaf->value(pos) = std::move(v);
+        }
+
+        std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        leaf->keys[pos] = k;
+        ++leaf->count;
+    }
+
+    // moves the upper half of a full leaf to a new one, linked after it
+    leaf_node* split(leaf_node* leaf)
+    {
+        leaf_node* right = allocate<leaf_node>();
+        const std::size_t half = leaf->count / 2;
+
+        for (std::size_t i = half; i < leaf->count; ++i)
+        {
+            new (&right->values[i - half]) Value(std::move(leaf->value(i)));
+            leaf->value(i).~Value();
+            right->keys[i - half] = leaf->keys[i];
+        }
+        right->count = leaf->count - std::uint32_t(half);
+        leaf->count = std::uint32_t(half);
+
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next)
+            leaf->next->prev = right;
+        else
+            _last = right;
+        leaf->next = right;
+
+        return right;
+    }
+
+    // adds `right` after the child the path went through, splitting full nodes up to the root
+    void insert_separator(inner_node** path, const std::size_t* positions, key_type separator, node* right)
+    {
+        for (std::size_t level = _height; level-- > 0; )
+        {
+            inner_node* inner = path[level];
+            const std::size_t pos = positions[level];
+
+            std::copy_backward(inner->keys + pos, inner->keys + inner->count, inner->keys + inner->count + 1);
+            std::copy_backward(inner->children + pos + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+            inner->keys[pos] = separator;
+            inner->children[pos + 1] = right;
+            ++inner->count;
+
+            if (inner->count <= InnerSlots)
+                return;
+
+            // the middle key moves up
+            inner_node* sibling = allocate<inner_node>();
+            const std::size_t middle = inner->count / 2;
+
+            std::copy(inner->keys + middle + 1, inner->keys + inner->count, sibling->keys);
+            std::copy(inner->children + middle + 1, inner->children + inner->count + 1, sibling->children);
+            sibling->count = inner->count - std::uint32_t(middle) - 1;
+            inner->count = std::uint32_t(middle);
+
+            separator = inner->keys[middle];
+            right = sibling;
+        }
+
+        inner_node* root = allocate<inner_node>();
+        root->keys[0] = separator;
+        root->children[0] = _root;
+        root->children[1] = right;
+        root->count = 1;
+
+        _root = root;
+        ++_height;
+    }
+
+    node* _root = {};
+    leaf_node* _first = {};
+    leaf_node* _last = {};
+    std::size_t _height = {};   // of inner levels
+    std::size_t _size = {};
+    key_from_value _key;
+    key_compare _comp;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "flat_multi_index.h"
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/mpl/at.hpp>
+#include <boost/mpl/size.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+// Loads [first, last) into a container in one go; elements are moved out of the range,
+// which may also be reordered.
+//
+// boost::multi_index_container does not expose its trees, so the best we can do through the
+// public interface is to sort the range once by the first index and insert with an end()
+// hint: the first ordered index is then appended in amortized constant time, the other
+// indexes still pay a regular insertion, so a 16 index container loads hardly faster than
+// by inserting. Containers that can do better provide a bulk_load(first, last) member,
+// which is used instead.
+//
+// Tables rebuilt in one go, such as reference data reloaded nightly, can be reloaded into
+// flat_multi_index_for<Container> instead: the flat_multi_index with the same orderings,
+// whose bulk_load() sorts each index once, and which answers the same get<N>() lookups.
+
+template <typename Container, typename Iterator>
+auto bulk_load(Container& c, Iterator first, Iterator last) -> decltype(c.bulk_load(first, last))
+{
+    return c.bulk_load(first, last);
+}
+
+// the same, the indexes built by up to `threads` threads for containers which can
+template <typename Container, typename Iterator>
+auto bulk_load(Container& c, Iterator first, Iterator last, std::size_t threads) -> decltype(c.bulk_load(first, last, threads))
+{
+    return c.bulk_load(first, last, threads);
+}
+
+template <typename Value, typename IndexSpecifierList, typename Allocator, typename Iterator>
+void bulk_load(boost::multi_index_container<Value, IndexSpecifierList, Allocator>& c, Iterator first, Iterator last)
+{
+    auto& index = c.template get<0>();
+    const auto key = index.key_extractor();
+    const auto comp = index.key_comp();
+
+    std::stable_sort(first, last, [&](const Value& lhs, const Value& rhs) { return comp(key(lhs), key(rhs)); });
+
+    for (; first != last; ++first)
+        index.emplace_hint(index.end(), std::move(*first));
+}
+
+namespace detail
+{
+
+// ordered_non_unique indexes only: a flat index has neither uniqueness nor hashing
+template <typename Spec>
+struct flat_ordered_for;
+
+template <typename Arg1, typename Arg2, typename Arg3>
+struct flat_ordered_for<boost::multi_index::ordered_non_unique<Arg1, Arg2, Arg3>>
+{
+    using spec = boost::multi_index::ordered_non_unique<Arg1, Arg2, Arg3>;
+    using type = flat_ordered<typename spec::key_from_value_type, typename spec::compare_type>;
+};
+
+template <typename Container, std::size_t... Is>
+auto flat_multi_index_for(std::index_sequence<Is...>) -> flat_multi_index<
+    typename Container::value_type,
+    typename flat_ordered_for<typename boost::mpl::at_c<typename Container::index_specifier_type_list, Is>::type>::type...
+>;
+
+}
+
+template <typename Container>
+using flat_multi_index_for = decltype(detail::flat_multi_index_for<Container>(
+    std::make_index_sequence<boost::mpl::size<typename Container::index_specifier_type_list>::value>{}));
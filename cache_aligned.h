@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Base of the types aligned on cache lines to keep their hot members apart, so that they
+// stay aligned when allocated with new: before C++17 a new-expression ignores alignments
+// stricter than max_align_t.
+struct cache_aligned
+{
+    static const std::size_t CacheLineSize = 64;
+
+    static void* operator new(std::size_t n)
+    {
+        void* p = ::aligned_alloc(CacheLineSize, (n + CacheLineSize - 1) / CacheLineSize * CacheLineSize);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void operator delete(void* p)
+    {
+        std::free(p);
+    }
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <boost/tokenizer.hpp>
+
+#include <emmintrin.h>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <experimental/string_view>
+
+// Instrument files are lines of "<exchange>,<market_ref>,<price>".
+
+template <typename StringT, typename Callable>
+void load_file(StringT&& filename, Callable f)
+{
+    std::ifstream ifs(filename);
+    boost::char_separator<char> sep(",");
+
+    for (std::string line; std::getline(ifs, line); )
+    {
+        boost::tokenizer<boost::char_separator<char>> tok(line, sep);
+        assert(std::distance(tok.begin(), tok.end()) == 3);
+
+        auto it = tok.begin();
+        ++it; // skip the 1st field
+        std::string ref = *it;
+        ++it;
+        double price = std::stof(*it);
+
+        f(ref, price);
+    }
+}
+
+// Read-only mapping of a whole file; string_views handed out by load_mapped_file() point
+// into it and stay valid as long as the mapped_file lives.
+struct mapped_file
+{
+    explicit mapped_file(const std::string& filename)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::system_error(errno, std::generic_category(), "open " + filename);
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1)
+        {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "fstat " + filename);
+        }
+
+        _size = static_cast<std::size_t>(st.st_size);
+        if (_size > 0)
+        {
+            void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "mmap " + filename);
+            }
+
+            ::madvise(p, _size, MADV_SEQUENTIAL);
+            _data = static_cast<const char*>(p);
+        }
+
+        ::close(fd);
+    }
+
+    ~mapped_file()
+    {
+        if (_data)
+            ::munmap(const_cast<char*>(_data), _size);
+    }
+
+    mapped_file(const mapped_file&) =delete;
+    mapped_file& operator=(const mapped_file&) =delete;
+
+    const char* data() const { return _data; }
+    std::size_t size() const { return _size; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+
+private:
+    const char* _data = {};
+    std::size_t _size = {};
+};
+
+namespace detail
+{
+
+// first occurrence of delim or '\n' in [first, last), 16 bytes at a time
+inline const char* find_field_end(const char* first, const char* last, char delim)
+{
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    for (; last - first >= 16; first += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, d), _mm_cmpeq_epi8(chunk, nl)));
+        if (mask)
+            return first + __builtin_ctz(mask);
+    }
+
+    while (first != last && *first != delim && *first != '\n')
+        ++first;
+    return first;
+}
+
+}
+
+// from_chars-like parsing of "[-]digits[.digits]": returns the end of the number, or first
+// if there is none. With up to 15 significant digits the mantissa is exactly representable
+// and a single division by an exact power of ten rounds correctly; longer numbers and
+// exponents go through strtod.
+inline const char* parse_price(const char* first, const char* last, double& value)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* p = first;
+    const bool negative = p != last && *p == '-';
+    if (negative)
+        ++p;
+
+    std::uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int fraction_digits = 0;
+    int digits = 0;
+
+    auto accumulate = [&](char c)
+    {
+        if (mantissa != 0 || c != '0')
+            ++significant_digits;
+        mantissa = mantissa * 10 + unsigned(c - '0');
+        ++digits;
+    };
+
+    for (; p != last && unsigned(*p - '0') < 10; ++p)
+        accumulate(*p);
+
+    if (p != last && *p == '.')
+        for (++p; p != last && unsigned(*p - '0') < 10; ++p, ++fraction_digits)
+            accumulate(*p);
+
+    if (digits == 0)
+        return first;
+
+    if (significant_digits > 15 || fraction_digits > 22 || (p != last && (*p == 'e' || *p == 'E')))
+    {
+        const std::string copy(first, std::min<std::size_t>(last - first, 64));
+        char* end;
+        value = std::strtod(copy.c_str(), &end);
+        return first + (end - copy.c_str());
+    }
+
+    value = double(mantissa) / pow10[fraction_digits];
+    if (negative)
+        value = -value;
+    return p;
+}
+
+// Same callback shape as load_file, but f gets a string_view into the mapping instead of
+// a std::string, and nothing is allocated per line.
+template <typename Callable>
+void load_mapped_range(const char* first, const char* last, Callable f)
+{
+    while (first != last)
+    {
+        const char* exchange_end = detail::find_field_end(first, last, ',');
+        if (exchange_end == last || *exchange_end != ',')
+            throw std::runtime_error("malformed line: " + std::string(first, exchange_end));
+
+        const char* ref = exchange_end + 1;
+        const char* ref_end = detail::find_field_end(ref, last, ',');
+        if (ref_end == last || *ref_end != ',')
+            throw std::runtime_error("malformed line: " + std::string(first, ref_end));
+
+        double price;
+        const char* price_end = parse_price(ref_end + 1, last, price);
+        if (price_end == ref_end + 1)
+            throw std::runtime_error("malformed price: " + std::string(first, price_end));
+
+        f(std::experimental::string_view(ref, ref_end - ref), price);
+
+        first = detail::find_field_end(price_end, last, '\n');
+        if (first != last)
+            ++first;
+    }
+}
+
+template <typename Callable>
+void load_mapped_file(const mapped_file& file, Callable f)
+{
+    load_mapped_range(file.begin(), file.end(), f);
+}
+
+// Splits [first, last) into at most n chunks of about the same size, each ending right
+// after a '\n' (or at last), so that every line belongs to exactly one chunk.
+inline std::vector<std::pair<const char*, const char*>> split_lines(const char* first, const char* last, std::size_t n)
+{
+    std::vector<std::pair<const char*, const char*>> chunks;
+    const std::size_t chunk_size = (last - first + n - 1) / std::max<std::size_t>(n, 1);
+
+    while (first != last)
+    {
+        const char* end = last - first > std::ptrdiff_t(chunk_size) ? first + chunk_size : last;
+        end = detail::find_field_end(end, last, '\n');
+        if (end != last)
+            ++end;
+
+        chunks.emplace_back(first, end);
+        first = end;
+    }
+
+    return chunks;
+}
+
+// Parses the file on up to `threads` threads, each filling its own default-constructed
+// Shard through f(shard, ref, price); the shards are returned in file order so that the
+// caller can merge them or keep them as they are.
+template <typename Shard, typename Callable>
+std::vector<Shard> load_mapped_file_parallel(const mapped_file& file, std::size_t threads, Callable f)
+{
+    const auto chunks = split_lines(file.begin(), file.end(), threads);
+
+    std::vector<Shard> shards(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+    std::vector<std::thread> workers;
+    workers.reserve(chunks.size());
+
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        workers.emplace_back([&, i]()
+        {
+            try
+            {
+                Shard& shard = shards[i];
+                load_mapped_range(chunks[i].first, chunks[i].second, [&](std::experimental::string_view ref, double price)
+                {
+                    f(shard, ref, price);
+                });
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto&& worker : workers)
+        worker.join();
+
+    for (auto&& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    return shards;
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "parallel_build.h"
+#include "tuple_for_each.h"
+
+#include <boost/iterator/iterator_adaptor.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Vector-backed alternative to boost::multi_index_container: elements live contiguously in
+// insertion order, and each ordered index is a sorted array of (key, position) entries.
+// Keys are copied into the index at insertion time, so lookups only touch the key column
+// and the element itself is reached through its position.
+//
+// Indexes are sorted lazily: emplace() appends to each index, and the first query after a
+// batch of insertions sorts the new entries and merges them into the sorted prefix.
+// This makes queries non-const under the hood, so a container must not be queried
+// concurrently from several threads.
+
+template <typename KeyFromValue, typename Compare = std::less<typename KeyFromValue::result_type>>
+struct flat_ordered
+{
+    using key_from_value = KeyFromValue;
+    using compare = Compare;
+};
+
+namespace detail
+{
+
+using flat_position = std::uint32_t;
+
+// How the entries of a flat_index reach their element: by position in the vector of a
+// flat_multi_index, whose data() iterators take when they are made, as the vector moves...
+template <typename Value>
+struct flat_by_position
+{
+    using handle = flat_position;
+
+    struct accessor
+    {
+        const Value& operator()(handle pos) const { return values[pos]; }
+
+        const Value* values;
+    };
+
+    accessor access() const { return accessor{values->data()}; }
+
+    const std::vector<Value>* values;
+};
+
+// ... or by address, for elements which stay where they are
+template <typename Value>
+struct flat_by_address
+{
+    using handle = const Value*;
+
+    struct accessor
+    {
+        const Value& operator()(handle v) const { return *v; }
+    };
+
+    accessor access() const { return accessor{}; }
+};
+
+template <typename Key, typename Handle>
+struct flat_entry
+{
+    Key key;
+    Handle element;
+};
+
+template <typename Value, typename EntryIterator, typename Accessor>
+struct flat_iterator :
+    public boost::iterator_adaptor<flat_iterator<Value, EntryIterator, Accessor>, EntryIterator, const Value>
+{
+    flat_iterator() =default;
+
+    flat_iterator(EntryIterator it, Accessor access) :
+        flat_iterator::iterator_adaptor_(it),
+        _access(access)
+    {}
+
+private:
+    friend class boost::iterator_core_access;
+
+    const Value& dereference() const { return _access(this->base()->element); }
+
+    Accessor _access = {};
+};
+
+template <typename Value, typename Spec, typename Locator = flat_by_position<Value>>
+class flat_index
+{
+public:
+    using key_from_value = typename Spec::key_from_value;
+    using key_compare = typename Spec::compare;
+    using key_type = typename key_from_value::result_type;
+    using value_type = Value;
+    using handle = typename Locator::handle;
+    using entry = flat_entry<key_type, handle>;
+
+    using const_iterator = flat_iterator<Value, typename std::vector<entry>::const_iterator, typename Locator::accessor>;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    explicit flat_index(Locator locator = Locator()) :
+        _locator(locator)
+    {}
+
+    void rebind(Locator locator) { _locator = locator; }
+
+    std::size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+
+    const_iterator begin() const { sort(); return make_iterator(_entries.cbegin()); }
+    const_iterator end() const { sort(); return make_iterator(_entries.cend()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const { return rbegin(); }
+    const_reverse_iterator crend() const { return rend(); }
+
+    const_iterator lower_bound(const key_type& k) const
+    {
+        sort();
+        return make_iterator(std::lower_bound(_entries.cbegin(), _entries.cend(), k, entry_key_compare{_comp}));
+    }
+
+    const_iterator upper_bound(const key_type& k) const
+    {
+        sort();
+        return make_iterator(std::upper_bound(_entries.cbegin(), _entries.cend(), k, entry_key_compare{_comp}));
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const key_type& k) const
+    {
+        sort();
+        auto range = std::equal_range(_entries.cbegin(), _entries.cend(), k, entry_key_compare{_comp});
+        return {make_iterator(range.first), make_iterator(range.second)};
+    }
+
+    const_iterator find(const key_type& k) const
+    {
+        sort();
+        auto it = std::lower_bound(_entries.cbegin(), _entries.cend(), k, entry_key_compare{_comp});
+        if (it == _entries.cend() || _comp(k, it->key))
+            return make_iterator(_entries.cend());
+        return make_iterator(it);
+    }
+
+    std::size_t count(const key_type& k) const
+    {
+        auto range = equal_range(k);
+        return std::distance(range.first, range.second);
+    }
+
+    void push(const Value& v, handle h)
+    {
+        _entries.push_back(entry{_key(v), h});
+    }
+
+    // appends the entries of values[first, values.size()) and sorts them right away
+    void push_range(const std::vector<Value>& values, std::size_t first)
+    {
+        _entries.reserve(_entries.size() + values.size() - first);
+        for (std::size_t pos = first; pos < values.size(); ++pos)
+            push(values[pos], static_cast<flat_position>(pos));
+        sort();
+    }
+
+    void reserve(std::size_t n) { _entries.reserve(n); }
+
+    // removes the entry of v, reached through h
+    void erase(const Value& v, handle h)
+    {
+        sort();
+        auto range = std::equal_range(_entries.begin(), _entries.end(), _key(v), entry_key_compare{_comp});
+        auto it = std::find_if(range.first, range.second, [&](const entry& e) { return e.element == h; });
+        if (it == range.second)
+            return;
+
+        _entries.erase(it);
+        _sorted = _entries.size();
+    }
+
+    void clear()
+    {
+        _entries.clear();
+        _sorted = 0;
+    }
+
+    // merges the entries appended since the last query into the sorted prefix; stable, so
+    // equivalent keys keep their insertion order as in ordered_non_unique
+    void sort() const
+    {
+        if (_sorted == _entries.size())
+            return;
+
+        auto middle = _entries.begin() + _sorted;
+        std::stable_sort(middle, _entries.end(), entry_key_compare{_comp});
+        std::inplace_merge(_entries.begin(), middle, _entries.end(), entry_key_compare{_comp});
+        _sorted = _entries.size();
+    }
+
+    key_from_value key_extractor() const { return _key; }
+    key_compare key_comp() const { return _comp; }
+
+private:
+    struct entry_key_compare
+    {
+        bool operator()(const entry& lhs, const key_type& rhs) const { return comp(lhs.key, rhs); }
+        bool operator()(const key_type& lhs, const entry& rhs) const { return comp(lhs, rhs.key); }
+        bool operator()(const entry& lhs, const entry& rhs) const { return comp(lhs.key, rhs.key); }
+
+        const key_compare& comp;
+    };
+
+    const_iterator make_iterator(typename std::vector<entry>::const_iterator it) const
+    {
+        return const_iterator(it, _locator.access());
+    }
+
+    Locator _locator;
+    mutable std::vector<entry> _entries;
+    mutable std::size_t _sorted = {};
+    key_from_value _key;
+    key_compare _comp;
+};
+
+}
+
+template <typename Value, typename... Indices>
+class flat_multi_index
+{
+    static_assert(sizeof...(Indices) > 0, "flat_multi_index needs at least one index");
+
+public:
+    using value_type = Value;
+    using size_type = std::size_t;
+
+    template <std::size_t N>
+    using nth_index = detail::flat_index<Value, typename std::tuple_element<N, std::tuple<Indices...>>::type>;
+
+    using const_iterator = typename nth_index<0>::const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = typename nth_index<0>::const_reverse_iterator;
+    using reverse_iterator = const_reverse_iterator;
+
+    flat_multi_index() :
+        _indices(detail::flat_index<Value, Indices>(detail::flat_by_position<Value>{&_values})...)
+    {}
+
+    flat_multi_index(const flat_multi_index&) =delete;
+    flat_multi_index& operator=(const flat_multi_index&) =delete;
+
+    flat_multi_index(flat_multi_index&& rhs) :
+        _values(std::move(rhs._values)),
+        _indices(std::move(rhs._indices))
+    {
+        rebind();
+    }
+
+    flat_multi_index& operator=(flat_multi_index&& rhs)
+    {
+        _values = std::move(rhs._values);
+        _indices = std::move(rhs._indices);
+        rebind();
+        return *this;
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args)
+    {
+        _values.emplace_back(std::forward<Args>(args)...);
+
+        const auto pos = static_cast<detail::flat_position>(_values.size() - 1);
+        for_each_index([&](auto& index) { index.push(_values.back(), pos); });
+    }
+
+    // moves [first, last) in, then sorts each index once over the new elements and merges
+    // them in linear time, instead of going through emplace() element by element
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        bulk_load(first, last, 1);
+    }
+
+    // the indexes only read the elements, so each can be sorted on its own thread
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last, std::size_t threads)
+    {
+        const std::size_t offset = _values.size();
+        _values.insert(_values.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+
+        parallel_for_each(_indices, [&](auto& index) { index.push_range(_values, offset); }, threads);
+    }
+
+    void reserve(std::size_t n)
+    {
+        _values.reserve(n);
+        for_each_index([&](auto& index) { index.reserve(n); });
+    }
+
+    void clear()
+    {
+        _values.clear();
+        for_each_index([&](auto& index) { index.clear(); });
+    }
+
+    std::size_t size() const { return _values.size(); }
+    bool empty() const { return _values.empty(); }
+
+    // like flushing a std::vector before binary searching it, fetching a view merges its
+    // pending entries so that the following queries see a sorted index
+    template <std::size_t N>
+    const nth_index<N>& get() const
+    {
+        const auto& index = std::get<N>(_indices);
+        index.sort();
+        return index;
+    }
+
+    const_iterator begin() const { return get<0>().begin(); }
+    const_iterator end() const { return get<0>().end(); }
+    const_iterator cbegin() const { return get<0>().cbegin(); }
+    const_iterator cend() const { return get<0>().cend(); }
+    const_reverse_iterator rbegin() const { return get<0>().rbegin(); }
+    const_reverse_iterator rend() const { return get<0>().rend(); }
+    const_reverse_iterator crbegin() const { return get<0>().crbegin(); }
+    const_reverse_iterator crend() const { return get<0>().crend(); }
+
+    template <typename Key>
+    const_iterator find(const Key& k) const
+    {
+        return get<0>().find(k);
+    }
+
+private:
+    template <typename F>
+    void for_each_index(F f)
+    {
+        detail::for_each_in_tuple(_indices, f);
+    }
+
+    void rebind()
+    {
+        for_each_index([&](auto& index) { index.rebind(detail::flat_by_position<Value>{&_values}); });
+    }
+
+    std::vector<Value> _values;
+    std::tuple<detail::flat_index<Value, Indices>...> _indices;
+};
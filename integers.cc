@@ -3,6 +3,8 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include "bench/bench.h"
+
 #include <algorithm>
 #include <iostream>
 #include <random>
@@ -57,98 +59,95 @@ struct hash<A>
 
 using namespace boost::multi_index;
 
-int main()
-{
-    auto benchmark = [](auto&& operation, const char* desc)
-    {
-        static const int Iterations = 1e6;
-
-        auto start = std::chrono::steady_clock::now();
-        for (int i = 0; i < Iterations; ++i)
-            operation();
-        auto end = std::chrono::steady_clock::now();
-
-        std::cout << desc << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
-    };
+static const int Iterations = 1e6;
 
+// both benchmarks use the same range of integers
+static const auto seed = std::random_device{}();
 
-    std::random_device rd;
-    auto seed = rd();
-
+void mic(bench::context& ctx)
+{
     std::mt19937 gen(seed);
     std::uniform_int_distribution<> rng(0, 1e6);
     volatile int x = 0; // its only reason is to avoid the compiler to optimize lookups
 
+    boost::multi_index_container<
+      A,
+      indexed_by<
+        ordered_unique<
+          tag<tags::x_asc>,
+          member<A, int, &A::x>
+        >,
+        ordered_unique<
+          tag<tags::y_asc>,
+          member<A, int, &A::y>
+        >,
+        hashed_unique<
+          tag<tags::unordered>,
+          identity<A>,
+          std::hash<A>
+        >
+      >
+    > mic;
+
+    ctx.run("insert", Iterations, [&]() { mic.emplace(rng(gen), rng(gen)); });
+
+    auto&& h = mic.get<tags::unordered>();
+    ctx.run("lookup", Iterations, [&]() { x += h.find(A(rng(gen), rng(gen))) != h.end(); });
+
+    auto&& asc = mic.get<tags::x_asc>();
+    auto it = asc.begin();
+    ctx.run("walk", Iterations, [&]()
     {
-        boost::multi_index_container<
-          A,
-          indexed_by<
-            ordered_unique<
-              tag<tags::x_asc>,
-              member<A, int, &A::x>
-            >,
-            ordered_unique<
-              tag<tags::y_asc>,
-              member<A, int, &A::y>
-            >,
-            hashed_unique<
-              tag<tags::unordered>,
-              identity<A>,
-              std::hash<A>
-            >
-          >
-        > mic;
-
-        benchmark([&]() { mic.emplace(rng(gen), rng(gen)); }, "boost.mic insert");
-
-        auto&& h = mic.get<tags::unordered>();
-        benchmark([&]() { x += h.find(A(rng(gen), rng(gen))) != h.end(); }, "boost.mic lookup");
-
-        auto&& asc = mic.get<tags::x_asc>();
-        auto it = asc.begin();
-        benchmark([&]()
-        {
-            if (it == asc.end())
-                it = asc.begin();
-            x += it->x;
-            ++it;
-        }, "boost.mic walk");
-        benchmark([&]() { h.erase(A(rng(gen), rng(gen))); }, "boost.mic erase");
-    }
+        if (it == asc.end())
+            it = asc.begin();
+        x += it->x;
+        ++it;
+    });
+    ctx.run("erase", Iterations, [&]() { h.erase(A(rng(gen), rng(gen))); });
+}
+
+void std_containers(bench::context& ctx)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> rng(0, 1e6);
+    volatile int x = 0;
 
-    // we use the same range of integers for the 2 tests
-    gen.seed(seed);
+    std::set<A, CompX> x_asc;
+    std::set<A, CompY> y_asc;
+    std::unordered_set<A> h;
 
+    ctx.run("insert", Iterations, [&]()
     {
-        std::set<A, CompX> x_asc;
-        std::set<A, CompY> y_asc;
-        std::unordered_set<A> h;
-
-        benchmark([&]()
-        {
-            A a{rng(gen), rng(gen)};
-            x_asc.insert(a);
-            y_asc.insert(a);
-            h.insert(a);
-        }, "std::sets insert");
-
-        benchmark([&]() { x += h.find(A(rng(gen), rng(gen))) != h.end(); }, "std::containers lookup");
-        auto it = x_asc.begin();
-        benchmark([&]()
-        {
-            if (it == x_asc.end())
-                it = x_asc.begin();
-            x += it->x;
-            ++it;
-        }, "std::set walk");
-        benchmark([&]()
-        {
-            A a{rng(gen), rng(gen)};
-            x_asc.erase(a);
-            y_asc.erase(a);
-            h.erase(a);
-        }, "std::containers erase");
-    }
+        A a{rng(gen), rng(gen)};
+        x_asc.insert(a);
+        y_asc.insert(a);
+        h.insert(a);
+    });
+
+    ctx.run("lookup", Iterations, [&]() { x += h.find(A(rng(gen), rng(gen))) != h.end(); });
+    auto it = x_asc.begin();
+    ctx.run("walk", Iterations, [&]()
+    {
+        if (it == x_asc.end())
+            it = x_asc.begin();
+        x += it->x;
+        ++it;
+    });
+    ctx.run("erase", Iterations, [&]()
+    {
+        A a{rng(gen), rng(gen)};
+        x_asc.erase(a);
+        y_asc.erase(a);
+        h.erase(a);
+    });
+}
 
-    return 0;
+static bench::registrar benchmarks[] = {
+    {"boost.mic", mic},
+    {"std::containers", std_containers},
+};
+
+int main(int argc, char** argv)
+{
+    return bench::run(argc, argv);
 }
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "parallel_build.h"
+#include "pool_allocator.h"
+#include "tuple_for_each.h"
+
+#include <boost/intrusive/set.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Intrusive alternative to boost::multi_index_container: the element type carries the tree
+// links of every index (one hook of 3 pointers per index, the color packed in the parent),
+// so an element is a single allocation holding its data and all its links, instead of a
+// node allocated by the container around a copy of it.
+//
+// intrusive_multi_index links elements the caller owns and which must outlive their
+// membership; pooled_multi_index owns its elements and allocates them from the node_pool
+// of their size.
+
+// hook of the index tagged Tag
+template <typename Tag>
+using intrusive_hook = boost::intrusive::set_base_hook<
+    boost::intrusive::tag<Tag>,
+    boost::intrusive::link_mode<boost::intrusive::normal_link>,
+    boost::intrusive::optimize_size<true>
+>;
+
+// Value with the hooks of the given tags, for element types which do not derive from them
+template <typename Value, typename... Tags>
+struct intrusive_hooked : public Value, public intrusive_hook<Tags>...
+{
+    using Value::Value;
+};
+
+template <typename Tag, typename KeyFromValue, typename Compare = std::less<typename KeyFromValue::result_type>>
+struct intrusive_ordered
+{
+    using tag = Tag;
+    using key_from_value = KeyFromValue;
+    using compare = Compare;
+};
+
+namespace detail
+{
+
+// boost.intrusive names the key type `type`
+template <typename KeyFromValue>
+struct intrusive_key_of_value : public KeyFromValue
+{
+    using type = typename KeyFromValue::result_type;
+};
+
+template <typename Value, typename Spec>
+using intrusive_index = boost::intrusive::multiset<
+    Value,
+    boost::intrusive::base_hook<intrusive_hook<typename Spec::tag>>,
+    boost::intrusive::key_of_value<intrusive_key_of_value<typename Spec::key_from_value>>,
+    boost::intrusive::compare<typename Spec::compare>,
+    boost::intrusive::constant_time_size<false>
+>;
+
+}
+
+template <typename Value, typename... Indices>
+class intrusive_multi_index
+{
+    static_assert(sizeof...(Indices) > 0, "intrusive_multi_index needs at least one index");
+
+public:
+    using value_type = Value;
+    using size_type = std::size_t;
+
+    template <std::size_t N>
+    using nth_index = detail::intrusive_index<Value, typename std::tuple_element<N, std::tuple<Indices...>>::type>;
+
+    using iterator = typename nth_index<0>::iterator;
+    using const_iterator = typename nth_index<0>::const_iterator;
+    using reverse_iterator = typename nth_index<0>::reverse_iterator;
+    using const_reverse_iterator = typename nth_index<0>::const_reverse_iterator;
+
+    intrusive_multi_index() =default;
+
+    // the elements stay where they are, with stale links
+    ~intrusive_multi_index() =default;
+
+    intrusive_multi_index(const intrusive_multi_index&) =delete;
+    intrusive_multi_index& operator=(const intrusive_multi_index&) =delete;
+
+    void insert(Value& v)
+    {
+        for_each_index([&](auto& index) { index.insert(v); });
+        ++_size;
+    }
+
+    // links [first, last) into each index in key order, so that every insertion lands at
+    // the end of the tree: the rebalancing remains but not the descent from the root
+    template <typename Iterator>
+    void insert(Iterator first, Iterator last, std::size_t threads = 1)
+    {
+        std::vector<Value*> values;
+        for (; first != last; ++first)
+            values.push_back(&*first);
+
+        // an index only writes its own hook in each element, so indexes can be linked by
+        // different threads, though hooks of the same element share cache lines; each index
+        // sorts its own copy, ties in insertion order
+        parallel_for_each(_indices, [&](auto& index)
+        {
+            const auto comp = index.value_comp();
+            std::vector<Value*> sorted(values);
+            std::stable_sort(sorted.begin(), sorted.end(), [&](const Value* lhs, const Value* rhs) { return comp(*lhs, *rhs); });
+
+            for (Value* v : sorted)
+                index.insert(index.end(), *v);
+        }, threads);
+
+        _size += values.size();
+    }
+
+    // unlinks v from every index
+    void erase(Value& v)
+    {
+        for_each_index([&](auto& index) { index.erase(index.iterator_to(v)); });
+        --_size;
+    }
+
+    void clear()
+    {
+        for_each_index([](auto& index) { index.clear(); });
+        _size = 0;
+    }
+
+    // unlinks everything and hands each element to disposer(Value*)
+    template <typename Disposer>
+    void clear_and_dispose(Disposer disposer)
+    {
+        // with normal links clearing an index does not touch the elements, so the disposed
+        // ones are never read again
+        std::get<0>(_indices).clear_and_dispose(disposer);
+        clear();
+    }
+
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    template <std::size_t N>
+    nth_index<N>& get() { return std::get<N>(_indices); }
+
+    template <std::size_t N>
+    const nth_index<N>& get() const { return std::get<N>(_indices); }
+
+    iterator begin() { return get<0>().begin(); }
+    iterator end() { return get<0>().end(); }
+    const_iterator begin() const { return get<0>().begin(); }
+    const_iterator end() const { return get<0>().end(); }
+    const_iterator cbegin() const { return get<0>().cbegin(); }
+    const_iterator cend() const { return get<0>().cend(); }
+    reverse_iterator rbegin() { return get<0>().rbegin(); }
+    reverse_iterator rend() { return get<0>().rend(); }
+    const_reverse_iterator crbegin() const { return get<0>().crbegin(); }
+    const_reverse_iterator crend() const { return get<0>().crend(); }
+
+    template <typename Key>
+    iterator find(const Key& k)
+    {
+        return get<0>().find(k);
+    }
+
+private:
+    template <typename F>
+    void for_each_index(F f)
+    {
+        detail::for_each_in_tuple(_indices, f);
+    }
+
+    std::tuple<detail::intrusive_index<Value, Indices>...> _indices;
+    std::size_t _size = {};
+};
+
+// intrusive_multi_index owning its elements: they are constructed in the node_pool of
+// sizeof(Value), so inserting N elements calls malloc N / nodes_per_chunk times
+template <typename Value, typename... Indices>
+class pooled_multi_index : public intrusive_multi_index<Value, Indices...>
+{
+    using base = intrusive_multi_index<Value, Indices...>;
+
+public:
+    pooled_multi_index() =default;
+
+    ~pooled_multi_index()
+    {
+        clear();
+    }
+
+    template <typename... Args>
+    Value& emplace(Args&&... args)
+    {
+        Value& v = create(std::forward<Args>(args)...);
+        base::insert(v);
+        return v;
+    }
+
+    // moves [first, last) in, then links the new elements index by index in key order
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last, std::size_t threads = 1)
+    {
+        std::vector<Value*> values;
+        values.reserve(std::distance(first, last));
+        for (; first != last; ++first)
+            values.push_back(&create(std::move(*first)));
+
+        base::insert(boost::make_indirect_iterator(values.begin()), boost::make_indirect_iterator(values.end()), threads);
+    }
+
+    void erase(Value& v)
+    {
+        base::erase(v);
+        destroy(&v);
+    }
+
+    void clear()
+    {
+        base::clear_and_dispose([](Value* v) { destroy(v); });
+    }
+
+private:
+    static auto& pool() { return node_pool<sizeof(Value), alignof(Value)>::instance(); }
+
+    template <typename... Args>
+    static Value& create(Args&&... args)
+    {
+        void* p = pool().allocate();
+        try
+        {
+            return *new (p) Value(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            pool().deallocate(p);
+            throw;
+        }
+    }
+
+    static void destroy(Value* v)
+    {
+        v->~Value();
+        pool().deallocate(v);
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <experimental/string_view>
+
+// Fixed-width market reference: an ISIN is 12 characters, stored zero-padded in 16 bytes
+// so that equality is one SSE2 compare and hashing mixes two 64-bit words.
+struct alignas(16) isin
+{
+    static const std::size_t Capacity = 16;
+
+    isin()
+    {
+        std::memset(_data, 0, Capacity);
+    }
+
+    isin(const char* s, std::size_t len)
+    {
+        if (len > Capacity)
+            throw std::length_error("market reference " + std::string(s, len) + " does not fit in 16 bytes");
+
+        std::memset(_data, 0, Capacity);
+        std::memcpy(_data, s, len);
+    }
+
+    explicit isin(std::experimental::string_view s) :
+        isin(s.data(), s.size())
+    {}
+
+    bool operator==(const isin& rhs) const
+    {
+        const __m128i lhs_bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(_data));
+        const __m128i rhs_bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(rhs._data));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(lhs_bytes, rhs_bytes)) == 0xffff;
+    }
+
+    bool operator!=(const isin& rhs) const { return !(*this == rhs); }
+
+    std::uint64_t low() const { std::uint64_t w; std::memcpy(&w, _data, sizeof(w)); return w; }
+    std::uint64_t high() const { std::uint64_t w; std::memcpy(&w, _data + 8, sizeof(w)); return w; }
+
+    std::experimental::string_view view() const { return {_data, ::strnlen(_data, Capacity)}; }
+
+private:
+    char _data[Capacity];
+};
+
+struct isin_hash
+{
+    std::size_t operator()(const isin& k) const
+    {
+        std::uint64_t h = (k.low() ^ (k.high() * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull;
+        return h ^ (h >> 31);
+    }
+};
+
+namespace std
+{
+
+template <>
+struct hash<isin> : isin_hash
+{
+};
+
+}
@@ -0,0 +1,126 @@
+#include "node_layout.h"
+
+#include "mtrace/mtrace.h"
+#include "mtrace/malloc_counter.h"
+#include "mtrace/malloc_sizes.h"
+
+#include <boost/multi_index/member.hpp>
+
+#include <iostream>
+#include <string>
+
+// Node layout and memory footprint of a few multi_index_container configurations at a
+// given size, checked against the allocations of the container actually built (unless
+// --estimate-only, for sizes that do not fit in memory).
+//
+// usage: layout [--estimate-only] [elements]
+
+using namespace boost::multi_index;
+
+// 17 bytes of data, 20 with its own padding, and padded again to the links' alignment
+struct row
+{
+    explicit row(int i) :
+        id(i), x(i), y(i), price(float(i)), side(i % 2 ? 'B' : 'S')
+    {}
+
+    int id;
+    int x;
+    int y;
+    float price;
+    char side;
+};
+
+template <typename Container>
+void report(const std::string& name, std::size_t elements, bool verify)
+{
+    const node_layout<Container> layout(elements);
+
+    std::cout << name << std::endl;
+    layout.print(std::cout);
+
+    if (!verify)
+        return;
+
+    malloc_sizes::enable();
+    {
+        mtrace<malloc_counter, malloc_sizes> mt;
+        Container c;
+        for (std::size_t i = 0; i < elements; ++i)
+            c.emplace(int(i));
+
+        const malloc_counter counter = mt.get<0>();
+        const malloc_sizes sizes = mt.get<1>();
+
+        std::size_t blocks = 0, bytes = 0;
+        for (auto&& s : sizes.classes())
+        {
+            blocks += s.second.live();
+            bytes += s.first * s.second.live();
+        }
+
+        std::cout << "  measured: " << counter.malloc_calls() << " allocations (estimated " << layout.allocations() << "), "
+                  << blocks << " blocks (estimated " << layout.blocks() << "), "
+                  << bytes << " bytes (estimated " << layout.bytes() << ", "
+                  << (layout.bytes() ? 100.0 * (double(bytes) - double(layout.bytes())) / double(layout.bytes()) : 0.0) << "%)" << std::endl;
+    }
+    malloc_sizes::enable(false);
+}
+
+// the indexes memory.cc looks at
+using Mixed = boost::multi_index_container<
+    row,
+    indexed_by<
+        hashed_unique<member<row, int, &row::id>>,
+        hashed_non_unique<member<row, int, &row::x>>,
+        ordered_unique<member<row, int, &row::id>>,
+        random_access<>
+    >
+>;
+
+using Ordered1 = boost::multi_index_container<
+    row,
+    indexed_by<
+        ordered_non_unique<member<row, int, &row::x>>
+    >
+>;
+
+using Ordered4 = boost::multi_index_container<
+    row,
+    indexed_by<
+        ordered_non_unique<member<row, int, &row::x>>,
+        ordered_non_unique<member<row, int, &row::y>>,
+        ordered_non_unique<member<row, int, &row::x>, std::greater<int>>,
+        ordered_non_unique<member<row, int, &row::y>, std::greater<int>>
+    >
+>;
+
+using Ranked = boost::multi_index_container<
+    row,
+    indexed_by<
+        ranked_unique<member<row, int, &row::id>>,
+        sequenced<>,
+        hashed_unique<member<row, int, &row::id>>
+    >
+>;
+
+int main(int argc, char** argv)
+{
+    std::size_t elements = 1000000;
+    bool verify = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "--estimate-only")
+            verify = false;
+        else
+            elements = std::size_t(std::stod(arg));
+    }
+
+    report<Mixed>("hashed_unique, hashed_non_unique, ordered_unique, random_access", elements, verify);
+    report<Ordered1>("ordered_non_unique", elements, verify);
+    report<Ordered4>("4 x ordered_non_unique", elements, verify);
+    report<Ranked>("ranked_unique, sequenced, hashed_unique", elements, verify);
+    return 0;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "bulk_load.h"
+#include "flat_multi_index.h"
+#include "tuple_for_each.h"
+
+#include <boost/multi_index_container.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A boost::multi_index_container whose secondary indexes are lazy: inserting only updates
+// the container (the primary indexes) and appends the element to a pending log, and a lazy
+// index catches up with the log in one batch, sorting the new entries and merging them in,
+// on its first query after changes. Indexes which are seldom queried cost a pointer per
+// insertion instead of a tree insertion each.
+//
+// Lazy indexes are the flat_index of flat_multi_index, sorted arrays of (key, element)
+// entries, the elements living in the container's nodes. As with flat_multi_index, queries
+// are non-const under the hood, so a container must not be queried concurrently from
+// several threads; elements must not be modified through the container's own indexes,
+// which would leave stale keys behind.
+
+template <typename KeyFromValue, typename Compare = std::less<typename KeyFromValue::result_type>>
+struct lazy_ordered
+{
+    using key_from_value = KeyFromValue;
+    using compare = Compare;
+};
+
+namespace detail
+{
+
+// a flat_index of the elements in the container's nodes, which catches up with the log of
+// the container's insertions
+template <typename Value, typename Spec>
+class lazy_index : public flat_index<Value, Spec, flat_by_address<Value>>
+{
+public:
+    // entries of log[applied, end), pushed then sorted and merged in by the flat_index
+    void catch_up(const std::vector<const Value*>& log)
+    {
+        if (_applied == log.size())
+            return;
+
+        // no exact reserve, which would reallocate everything on every catch-up
+        for (std::size_t i = _applied; i < log.size(); ++i)
+            this->push(*log[i], log[i]);
+        _applied = log.size();
+
+        this->sort();
+    }
+
+    std::size_t applied() const { return _applied; }
+
+    // the log got truncated or lost an entry already applied
+    void rebase(std::size_t applied) { _applied = applied; }
+
+    void erase(const Value& v)
+    {
+        flat_index<Value, Spec, flat_by_address<Value>>::erase(v, &v);
+    }
+
+    void clear()
+    {
+        flat_index<Value, Spec, flat_by_address<Value>>::clear();
+        _applied = 0;
+    }
+
+private:
+    std::size_t _applied = {};
+};
+
+}
+
+// Container is the multi_index_container of the eagerly maintained indexes; get<0>() is its
+// first index and get<N>() the (N - 1)th lazy index, caught up with the pending log.
+template <typename Container, typename... LazyIndices>
+class lazy_multi_index
+{
+    static_assert(sizeof...(LazyIndices) > 0, "lazy_multi_index needs at least one lazy index");
+
+public:
+    using value_type = typename Container::value_type;
+    using size_type = std::size_t;
+    using container_type = Container;
+
+    template <std::size_t N>
+    using nth_lazy_index = detail::lazy_index<value_type, typename std::tuple_element<N, std::tuple<LazyIndices...>>::type>;
+
+    using const_iterator = typename Container::const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = typename Container::const_reverse_iterator;
+    using reverse_iterator = const_reverse_iterator;
+
+    lazy_multi_index() =default;
+
+    lazy_multi_index(const lazy_multi_index&) =delete;
+    lazy_multi_index& operator=(const lazy_multi_index&) =delete;
+
+    template <typename... Args>
+    std::pair<const_iterator, bool> emplace(Args&&... args)
+    {
+        auto result = _container.emplace(std::forward<Args>(args)...);
+        if (result.second)
+            _log.push_back(&*result.first);
+        return result;
+    }
+
+    // into an empty container through ::bulk_load(), then the whole container is pending
+    template <typename Iterator>
+    void bulk_load(Iterator first, Iterator last)
+    {
+        if (!_container.empty())
+        {
+            for (; first != last; ++first)
+                emplace(std::move(*first));
+            return;
+        }
+
+        ::bulk_load(_container, first, last);
+        _log.reserve(_container.size());
+        for (auto&& v : _container)
+            _log.push_back(&v);
+    }
+
+    // the lazy indexes which already hold the element lose it, the others forget it from the
+    // log; the log is scanned, which is cheap as long as it is caught up now and then
+    const_iterator erase(const_iterator it)
+    {
+        const value_type* v = &*it;
+        const auto pending = std::find(_log.begin(), _log.end(), v);
+        const std::size_t pos = pending == _log.end() ? std::numeric_limits<std::size_t>::max() : std::size_t(pending - _log.begin());
+
+        for_each_index([&](auto& index)
+        {
+            if (pos == std::numeric_limits<std::size_t>::max())
+                index.erase(*v);
+            else if (pos < index.applied())
+            {
+                index.erase(*v);
+                index.rebase(index.applied() - 1);
+            }
+        });
+
+        if (pending != _log.end())
+            _log.erase(pending);
+
+        return _container.erase(it);
+    }
+
+    void clear()
+    {
+        _container.clear();
+        _log.clear();
+        for_each_index([](auto& index) { index.clear(); });
+    }
+
+    std::size_t size() const { return _container.size(); }
+    bool empty() const { return _container.empty(); }
+
+    // elements inserted but not yet in every lazy index
+    std::size_t pending() const { return _log.size() - min_applied(); }
+
+    const Container& container() const { return _container; }
+
+    template <std::size_t N>
+    decltype(auto) get() const
+    {
+        return get(std::integral_constant<std::size_t, N>{});
+    }
+
+    const_iterator begin() const { return _container.begin(); }
+    const_iterator end() const { return _container.end(); }
+    const_iterator cbegin() const { return _container.cbegin(); }
+    const_iterator cend() const { return _container.cend(); }
+    const_reverse_iterator rbegin() const { return _container.rbegin(); }
+    const_reverse_iterator rend() const { return _container.rend(); }
+    const_reverse_iterator crbegin() const { return _container.crbegin(); }
+    const_reverse_iterator crend() const { return _container.crend(); }
+
+    template <typename Key>
+    const_iterator find(const Key& k) const
+    {
+        return _container.find(k);
+    }
+
+private:
+    decltype(auto) get(std::integral_constant<std::size_t, 0>) const
+    {
+        return _container.template get<0>();
+    }
+
+    template <std::size_t N>
+    const nth_lazy_index<N - 1>& get(std::integral_constant<std::size_t, N>) const
+    {
+        auto& index = std::get<N - 1>(_indices);
+        index.catch_up(_log);
+        truncate_log();
+        return index;
+    }
+
+    template <typename F>
+    void for_each_index(F f) const
+    {
+        detail::for_each_in_tuple(_indices, f);
+    }
+
+    std::size_t min_applied() const
+    {
+        std::size_t applied = _log.size();
+        for_each_index([&](const auto& index) { applied = std::min(applied, index.applied()); });
+        return applied;
+    }
+
+    // once every lazy index caught up, the log starts over
+    void truncate_log() const
+    {
+        if (min_applied() != _log.size())
+            return;
+
+        _log.clear();
+        for_each_index([](auto& index) { index.rebase(0); });
+    }
+
+    // caught up by the queries, as flat_multi_index sorts its indexes
+    Container _container;
+    mutable std::vector<const value_type*> _log;
+    mutable std::tuple<detail::lazy_index<value_type, LazyIndices>...> _indices;
+};
@@ -14,6 +14,7 @@
 
 #include "mtrace/mtrace.h"
 #include "mtrace/malloc_printer.h"
+#include "mtrace/malloc_sizes.h"
 
 using namespace boost::multi_index;
 
@@ -169,28 +170,41 @@ int main()
 	  >
 	> m;
 
+	malloc_sizes::enable();
+
 	A a(1, 2);
-	m.insert(A(1,2));
-	m.insert(A(2,2));
-	m.insert(A(3,2));
-	m.insert(A(4,2));
-	m.insert(A(5,2));
+	{
+		mtrace<malloc_sizes> mt;
+		m.insert(A(1,2));
+		m.insert(A(2,2));
+		m.insert(A(3,2));
+		m.insert(A(4,2));
+		m.insert(A(5,2));
+
+		std::cout << "insert 5 elements: allocation size classes" << std::endl;
+		mt.get<0>().print_top(std::cout, 10);
+	}
 
 #if 0
 	sv.clear();
 #endif
 
+	malloc_sizes sizes;
 	{
 		std::cout << "start" << std::endl;
-		mtrace<malloc_printer> mt;
+		mtrace<malloc_printer, malloc_sizes> mt;
 		auto p = m.insert(A(0x00f00ba3, 0x00f00ba3)).first;
 		std::cout << " elem = " << &(*p) << std::endl;
 
 		p = m.insert(A(0xdeadbeef, 0xdeadbeef)).first;
 		std::cout << " elem = " << &(*p) << std::endl;
 		std::cout << "stop" << std::endl;
+		sizes = mt.get<1>();
 	}
 
+	std::cout << "insert 2 elements: allocation size classes" << std::endl;
+	sizes.print_top(std::cout, 10);
+
 #if 0
 
 	for (auto&& s: sv)
@@ -1,14 +1,21 @@
 #pragma once
 
 #include "counter.h"
+#include "file_loader.h"
+#include "isin.h"
+#include "swiss_table.h"
+#include "perfect_hash.h"
+#include "seqlock.h"
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <experimental/string_view>
 
 namespace impl
@@ -112,6 +119,55 @@ private:
 };
 
 
+// stock with its market_ref packed for hashing and comparison; built by the isin providers
+// only, the others keep accepting references longer than an isin
+struct isin_stock : stock
+{
+    explicit isin_stock(const stock& s) :
+        stock(s),
+        market_ref_isin(s.market_ref.data(), s.market_ref.size())
+    {}
+
+    isin market_ref_isin;
+};
+
+struct market_data_provider_mic_isin
+{
+    static const char* name() { return "boost::mic<isin>"; }
+
+    void add_stock(const stock& s)
+    {
+        m_stocks.emplace(s);
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        auto& view = m_stocks.get<by_reference_isin>();
+
+        auto it = view.find(isin(market_ref, len));
+
+        if (it == view.end())
+            throw std::runtime_error("stock " + std::string(market_ref) + " not found");
+
+        const_cast<isin_stock&>(*it).price = new_price; // fine, price is not an index
+    }
+
+private:
+    struct by_reference_isin {};
+
+    boost::multi_index_container<
+      isin_stock,
+      indexed_by<
+        hashed_unique<
+          tag<by_reference_isin>,
+          member<isin_stock, isin, &isin_stock::market_ref_isin>,
+          isin_hash
+        >
+      >
+    > m_stocks;
+};
+
+
 struct market_data_provider_umap_string
 {
     static const char* name() { return "unordered_map<string>"; }
@@ -140,11 +196,13 @@ struct market_data_provider_umap_string_view
 {
     static const char* name() { return "unordered_map<string_view>"; }
 
-    void add_stock(const stock& ss)
+    // the key views the market_ref of a stock on the heap, which never moves: a stock held by
+    // value would move with the node, and short references live in the SSO buffer
+    void add_stock(const stock& s)
     {
-        stock s(ss);
-        std::experimental::string_view sv{s.market_ref};
-        m_stocks.emplace(sv, std::move(s));
+        auto p = std::make_unique<stock>(s);
+        std::experimental::string_view sv{p->market_ref};
+        m_stocks.emplace(sv, std::move(p));
     }
 
     void on_price_change(const char* market_ref, int len, double new_price)
@@ -152,6 +210,30 @@ struct market_data_provider_umap_string_view
         std::experimental::string_view ref_view(market_ref, len);
         auto it = m_stocks.find(ref_view);
 
+        if (it == m_stocks.end())
+            throw std::runtime_error("stock " + std::string(market_ref) + " not found");
+
+        it->second->price = new_price;
+    }
+
+private:
+    std::unordered_map<std::experimental::string_view, std::unique_ptr<stock>> m_stocks;
+};
+
+
+struct market_data_provider_umap_isin
+{
+    static const char* name() { return "unordered_map<isin>"; }
+
+    void add_stock(const stock& s)
+    {
+        m_stocks.emplace(isin(s.market_ref.data(), s.market_ref.size()), s);
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        auto it = m_stocks.find(isin(market_ref, len));
+
         if (it == m_stocks.end())
             throw std::runtime_error("stock " + std::string(market_ref) + " not found");
 
@@ -159,14 +241,248 @@ struct market_data_provider_umap_string_view
     }
 
 private:
-    std::unordered_map<std::experimental::string_view, stock> m_stocks;
+    std::unordered_map<isin, stock, isin_hash> m_stocks;
 };
 
+
+struct market_data_provider_swiss_string_view
+{
+    static const char* name() { return "swiss_table<string_view>"; }
+
+    void add_stock(const stock& s)
+    {
+        m_stocks.insert(s);
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        std::experimental::string_view ref_view(market_ref, len);
+        stock* s = m_stocks.find(ref_view);
+
+        if (!s)
+            throw std::runtime_error("stock " + std::string(market_ref) + " not found");
+
+        s->price = new_price;
+    }
+
+private:
+    swiss_table<
+      stock,
+      const_mem_fun<stock, std::experimental::string_view, &stock::get_market_ref_view>,
+      std::hash<std::experimental::string_view>
+    > m_stocks;
+};
+
+
+// stock of a mapped instrument file: market_ref views the reference in the mapping
+struct mapped_stock
+{
+    std::experimental::string_view get_market_ref_view() const { return market_ref; }
+
+    std::experimental::string_view market_ref;
+    double price;
+    int volume;
+};
+
+// Indexes instrument files without copying a key: the provider keeps the mappings of the
+// files it loaded for its whole lifetime, and every key views its reference in them.
+struct market_data_provider_mapped_file
+{
+    static const char* name() { return "swiss_table<mapped string_view>"; }
+
+    void load(const std::string& filename)
+    {
+        m_files.push_back(std::make_unique<mapped_file>(filename));
+        load_mapped_file(*m_files.back(), [&](std::experimental::string_view ref, double price)
+        {
+            m_stocks.emplace(mapped_stock{ref, price, 100});
+        });
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        std::experimental::string_view ref_view(market_ref, len);
+        mapped_stock* s = m_stocks.find(ref_view);
+
+        if (!s)
+            throw std::runtime_error("stock " + std::string(market_ref) + " not found");
+
+        s->price = new_price;
+    }
+
+    std::size_t size() const { return m_stocks.size(); }
+
+private:
+    std::vector<std::unique_ptr<mapped_file>> m_files;
+    swiss_table<
+      mapped_stock,
+      const_mem_fun<mapped_stock, std::experimental::string_view, &mapped_stock::get_market_ref_view>,
+      std::hash<std::experimental::string_view>
+    > m_stocks;
+};
+
+// The instrument universe is known once the reference file is loaded: rebuild() turns
+// everything added so far into a minimal perfect hash table. Stocks added afterwards wait
+// in a regular hash table, searched when the perfect hash misses, until the next rebuild().
+struct market_data_provider_perfect_hash
+{
+    static const char* name() { return "perfect_hash<string_view>"; }
+
+    void add_stock(const stock& s)
+    {
+        if (!m_stocks.find(s.get_market_ref_view()))
+            m_pending.emplace(s.market_ref, s);
+    }
+
+    void rebuild()
+    {
+        std::vector<stock> stocks = m_stocks.extract();
+        stocks.reserve(stocks.size() + m_pending.size());
+        for (auto&& p : m_pending)
+            stocks.push_back(std::move(p.second));
+
+        m_pending.clear();
+        m_stocks.build(std::move(stocks));
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        std::experimental::string_view ref_view(market_ref, len);
+        stock* s = m_stocks.find(ref_view);
+
+        if (!s)
+        {
+            auto it = m_pending.find(std::string(market_ref, len));
+            if (it == m_pending.end())
+                throw std::runtime_error("stock " + std::string(market_ref) + " not found");
+
+            s = &it->second;
+        }
+
+        s->price = new_price;
+    }
+
+    std::size_t memory_usage() const { return m_stocks.memory_usage(); }
+
+private:
+    perfect_hash_table<
+      stock,
+      const_mem_fun<stock, std::experimental::string_view, &stock::get_market_ref_view>,
+      std::hash<std::experimental::string_view>
+    > m_stocks;
+
+    std::unordered_map<std::string, stock> m_pending;
+};
+
+
+// market fields that change while the stock is indexed
+struct quote
+{
+    double price;
+    int volume;
+};
+
+// stock variant whose market fields can be read from any thread while one thread updates them
+struct concurrent_stock
+{
+    explicit concurrent_stock(const stock& s) :
+        market_ref(s.market_ref),
+        id(s.id),
+        market(quote{s.price, s.volume})
+    {}
+
+    std::experimental::string_view get_market_ref_view() const { return market_ref; }
+
+    std::string market_ref;
+    std::string id;
+    mutable seqlock<quote> market; // fine, not an index
+};
+
+// One feed thread calls on_price_change, any number of threads call get_quote concurrently:
+// the index is only modified by add_stock, before readers start.
+struct market_data_provider_seqlock
+{
+    static const char* name() { return "boost::mic<string_view> + seqlock"; }
+
+    void add_stock(const stock& s)
+    {
+        m_stocks.emplace(s);
+    }
+
+    void on_price_change(const char* market_ref, int len, double new_price)
+    {
+        const concurrent_stock& s = find(market_ref, len);
+
+        quote q = s.market.load();
+        q.price = new_price;
+        s.market.store(q);
+    }
+
+    void on_trade(const char* market_ref, int len, double price, int volume)
+    {
+        find(market_ref, len).market.store(quote{price, volume});
+    }
+
+    quote get_quote(const char* market_ref, int len) const
+    {
+        return find(market_ref, len).market.load();
+    }
+
+private:
+    const concurrent_stock& find(const char* market_ref, int len) const
+    {
+        auto& view = m_stocks.get<by_reference_view>();
+
+        std::experimental::string_view ref_view(market_ref, len);
+        auto it = view.find(ref_view);
+
+        if (it == view.end())
+            throw std::runtime_error("stock " + std::string(market_ref, len) + " not found");
+
+        return *it;
+    }
+
+    struct by_reference_view {};
+
+    boost::multi_index_container<
+      concurrent_stock,
+      indexed_by<
+        hashed_unique<
+          tag<by_reference_view>,
+          const_mem_fun<concurrent_stock, std::experimental::string_view, &concurrent_stock::get_market_ref_view>,
+          std::hash<std::experimental::string_view>
+        >
+      >
+    > m_stocks;
+};
+
+// providers built from the complete set of stocks (e.g. a perfect hash) are sealed after loading
+template <typename MarketDataProvider>
+auto finish_load(MarketDataProvider& mdp, int) -> decltype(mdp.rebuild(), void())
+{
+    mdp.rebuild();
+}
+
+template <typename MarketDataProvider>
+void finish_load(MarketDataProvider&, long)
+{
+}
+
 }
 
 using impl::stock;
 using impl::market_data_provider_mic_string;
 using impl::market_data_provider_mic_string_view;
+using impl::market_data_provider_mic_isin;
 using impl::market_data_provider_umap_string;
 using impl::market_data_provider_umap_string_view;
+using impl::market_data_provider_umap_isin;
+using impl::market_data_provider_swiss_string_view;
+using impl::mapped_stock;
+using impl::market_data_provider_mapped_file;
+using impl::market_data_provider_perfect_hash;
+using impl::quote;
+using impl::concurrent_stock;
+using impl::market_data_provider_seqlock;
+using impl::finish_load;
 
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "tsc_chrono.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+// HDR-style histogram of latencies in cycles: values below 2^SubBits are counted exactly,
+// above that each power of two is split into 2^SubBits linear buckets, so every recorded
+// value is known within 1/2^SubBits (~3%) whatever its magnitude. Fixed size, recording
+// never allocates.
+class latency_histogram
+{
+public:
+    static const int SubBits = 5;
+    static const std::uint64_t SubBuckets = 1 << SubBits;
+    static const std::size_t Buckets = (64 - SubBits + 1) * SubBuckets;
+
+    void record(std::int64_t cycles)
+    {
+        const std::uint64_t v = cycles > 0 ? static_cast<std::uint64_t>(cycles) : 0;
+
+        ++_counts[bucket_of(v)];
+        ++_count;
+        _min = std::min(_min, v);
+        _max = std::max(_max, v);
+    }
+
+    void clear()
+    {
+        _counts.fill(0);
+        _count = 0;
+        _min = std::numeric_limits<std::uint64_t>::max();
+        _max = 0;
+    }
+
+    std::uint64_t count() const { return _count; }
+    std::uint64_t min() const { return _count ? _min : 0; }
+    std::uint64_t max() const { return _max; }
+
+    // smallest recorded value such that `percentile`% of the values are lower or equal,
+    // up to the bucket resolution
+    std::uint64_t value_at_percentile(double percentile) const
+    {
+        if (_count == 0)
+            return 0;
+
+        const std::uint64_t rank = std::max<std::uint64_t>(1, std::ceil(percentile / 100.0 * _count));
+
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < Buckets; ++b)
+        {
+            seen += _counts[b];
+            if (seen >= rank)
+                return std::min(std::max(bucket_high(b), _min), _max);
+        }
+
+        return _max;
+    }
+
+private:
+    static std::size_t bucket_of(std::uint64_t v)
+    {
+        if (v < SubBuckets)
+            return v;
+
+        const int exponent = 63 - __builtin_clzll(v);
+        const int shift = exponent - SubBits;
+        return (shift + 1) * SubBuckets + ((v >> shift) - SubBuckets);
+    }
+
+    // highest value falling into bucket b
+    static std::uint64_t bucket_high(std::size_t b)
+    {
+        if (b < SubBuckets)
+            return b;
+
+        const int shift = static_cast<int>(b / SubBuckets) - 1;
+        const std::uint64_t low = (SubBuckets + b % SubBuckets) << shift;
+        return low + ((std::uint64_t(1) << shift) - 1);
+    }
+
+    std::array<std::uint64_t, Buckets> _counts = {};
+    std::uint64_t _count = 0;
+    std::uint64_t _min = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t _max = 0;
+};
+
+namespace detail
+{
+
+// cost of an empty start()/elapsed() pair, the smallest of many tries
+inline std::int64_t tsc_overhead()
+{
+    static const std::int64_t overhead = []()
+    {
+        std::int64_t best = std::numeric_limits<std::int64_t>::max();
+        tsc_chrono chrono;
+        for (int i = 0; i < 10000; ++i)
+        {
+            chrono.start();
+            best = std::min(best, chrono.elapsed());
+        }
+        return best;
+    }();
+
+    return overhead;
+}
+
+// cost of one iteration of record_latencies() around an empty call: the timer and the
+// record, averaged over a batch, the smallest of many batches
+inline std::int64_t record_overhead()
+{
+    static const std::int64_t overhead = []()
+    {
+        static const int Batch = 1000;
+        static latency_histogram scratch;
+
+        const std::int64_t timer = tsc_overhead();
+        std::int64_t best = std::numeric_limits<std::int64_t>::max();
+        tsc_chrono chrono, batch;
+        for (int i = 0; i < 100; ++i)
+        {
+            batch.start();
+            for (int j = 0; j < Batch; ++j)
+            {
+                chrono.start();
+                scratch.record(chrono.elapsed() - timer);
+            }
+            best = std::min(best, batch.elapsed());
+        }
+        return best / Batch;
+    }();
+
+    return overhead;
+}
+
+}
+
+// times each call of callable into h, timer overhead subtracted; returns what the timing
+// itself cost over all the iterations, for the caller to take out of its own total
+template <typename Callable>
+std::chrono::nanoseconds record_latencies(latency_histogram& h, std::size_t iterations, Callable&& callable)
+{
+    tsc_chrono::init();
+    const std::int64_t overhead = detail::tsc_overhead();
+
+    tsc_chrono chrono;
+    for (std::size_t i = 0; i < iterations; ++i)
+    {
+        chrono.start();
+        callable();
+        h.record(chrono.elapsed() - overhead);
+    }
+
+    return tsc_chrono::from_cycles(static_cast<std::int64_t>(iterations) * detail::record_overhead());
+}
+
+inline std::ostream& operator<<(std::ostream& os, const latency_histogram& h)
+{
+    auto ns = [](std::uint64_t cycles) { return tsc_chrono::from_cycles(cycles).count(); };
+
+    return os << "min=" << ns(h.min()) << "ns"
+              << " p50=" << ns(h.value_at_percentile(50)) << "ns"
+              << " p90=" << ns(h.value_at_percentile(90)) << "ns"
+              << " p99=" << ns(h.value_at_percentile(99)) << "ns"
+              << " p99.9=" << ns(h.value_at_percentile(99.9)) << "ns"
+              << " max=" << ns(h.max()) << "ns";
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "tsc_chrono.h"
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Allocation count, bytes and time per call site. Every allocation captures a short
+// backtrace (about a microsecond), so the handler does nothing until enable() is called.
+//
+// Call sites are resolved when reporting: the first frame of the executable that is not
+// part of the tracer or of the allocation plumbing (operator new, allocators, make_unique),
+// symbolized with dladdr, so the executable must export its symbols (-rdynamic).
+struct malloc_callsites
+{
+    static const std::size_t Depth = 16;
+
+    struct stats
+    {
+        std::size_t calls = {};
+        std::size_t bytes = {};
+        std::uint64_t cycles = {};
+
+        void merge(const stats& rhs)
+        {
+            calls += rhs.calls;
+            bytes += rhs.bytes;
+            cycles += rhs.cycles;
+        }
+    };
+
+    static void enable(bool on = true) { enabled_flag() = on; }
+    static bool enabled() { return enabled_flag(); }
+
+    void pre_malloc(size_t)
+    {
+        _chrono.start();
+    }
+
+    void post_malloc(size_t size, const void*)
+    {
+        record(size);
+    }
+
+    void pre_free(const void*) {}
+    void post_free(const void*) {}
+
+    void pre_realloc(const void*, size_t)
+    {
+        _chrono.start();
+    }
+
+    void post_realloc(const void*, size_t size, const void*)
+    {
+        record(size);
+    }
+
+    void merge(const malloc_callsites& rhs)
+    {
+        for (auto&& p : rhs._stacks)
+            _stacks[p.first].merge(p.second);
+    }
+
+    // the n call sites which allocated the most bytes
+    void print_top(std::ostream& os, std::size_t n) const
+    {
+        std::unordered_map<const void*, stats> sites;
+        for (auto&& p : _stacks)
+            sites[call_site(p.first)].merge(p.second);
+
+        std::vector<std::pair<const void*, stats>> sorted(sites.begin(), sites.end());
+        std::sort(sorted.begin(), sorted.end(), [](auto&& lhs, auto&& rhs) { return lhs.second.bytes > rhs.second.bytes; });
+        sorted.resize(std::min(n, sorted.size()));
+
+        os << std::setw(12) << "calls" << std::setw(14) << "bytes" << std::setw(10) << "avg ns" << "  call site" << std::endl;
+        for (auto&& p : sorted)
+        {
+            os << std::setw(12) << p.second.calls
+               << std::setw(14) << p.second.bytes
+               << std::setw(10) << tsc_chrono::from_cycles(p.second.cycles / std::max<std::size_t>(p.second.calls, 1)).count()
+               << "  " << symbolize(p.first) << std::endl;
+        }
+    }
+
+private:
+    using stack = std::array<void*, Depth>;
+
+    struct stack_hash
+    {
+        std::size_t operator()(const stack& s) const
+        {
+            std::size_t seed = 0;
+            for (void* frame : s)
+                seed ^= std::hash<void*>()(frame) + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+    static bool& enabled_flag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    void record(size_t size)
+    {
+        if (!enabled())
+            return;
+
+        const std::int64_t cycles = _chrono.elapsed();
+
+        stack s = {};
+        ::backtrace(s.data(), Depth);
+
+        stats& st = _stacks[s];
+        ++st.calls;
+        st.bytes += size;
+        st.cycles += cycles;
+    }
+
+    // frames the allocation goes through before reaching the code that asked for it
+    static bool is_plumbing(const std::string& name)
+    {
+        static const char* prefixes[] = {
+            "malloc", "calloc", "realloc", "aligned_alloc", "posix_memalign", "memalign",
+            "(anonymous namespace)::traced_malloc", "mtrace<", "malloc_callsites::",
+            "operator new", "std::allocator", "__gnu_cxx::new_allocator", "std::__new_allocator",
+            "std::allocator_traits", "boost::multi_index::detail::allocator_traits",
+            "std::make_unique", "std::unique_ptr", "pool_allocator", "node_pool",
+        };
+
+        for (const char* prefix : prefixes)
+            if (name.compare(0, std::strlen(prefix), prefix) == 0)
+                return true;
+        return false;
+    }
+
+    static std::string demangled(const char* name)
+    {
+        int status = 0;
+        char* d = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        std::string result(status == 0 && d ? d : name);
+        std::free(d);
+        return result;
+    }
+
+    static const void* executable_base()
+    {
+        Dl_info info;
+        return ::dladdr(reinterpret_cast<void*>(&malloc_callsites::executable_base), &info) ? info.dli_fbase : nullptr;
+    }
+
+    static const void* call_site(const stack& s)
+    {
+        const void* base = executable_base();
+        for (void* frame : s)
+        {
+            Dl_info info;
+            if (!frame || !::dladdr(frame, &info) || info.dli_fbase != base)
+                continue;
+
+            if (!info.dli_sname || !is_plumbing(demangled(info.dli_sname)))
+                return frame;
+        }
+
+        return nullptr;
+    }
+
+    static std::string symbolize(const void* frame)
+    {
+        static const std::size_t MaxLength = 160;
+
+        Dl_info info;
+        if (!frame || !::dladdr(frame, &info))
+            return "??";
+        if (!info.dli_sname)
+            return std::string(info.dli_fname) + "+" + std::to_string(static_cast<const char*>(frame) - static_cast<const char*>(info.dli_fbase));
+
+        // template arguments make up most of the name, the middle goes first
+        std::string name = demangled(info.dli_sname);
+        if (name.size() > MaxLength)
+            name = name.substr(0, MaxLength / 2) + "..." + name.substr(name.size() - (MaxLength / 2 - 3));
+        return name + "+" + std::to_string(static_cast<const char*>(frame) - static_cast<const char*>(info.dli_saddr));
+    }
+
+    std::unordered_map<stack, stats, stack_hash> _stacks;
+    tsc_chrono _chrono;
+};
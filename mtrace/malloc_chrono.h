@@ -56,6 +56,13 @@ struct malloc_chrono
         return tsc_chrono::from_cycles(_elapsed_time_realloc);
     }
 
+    void merge(const malloc_chrono& rhs)
+    {
+        _elapsed_time_malloc += rhs._elapsed_time_malloc;
+        _elapsed_time_free += rhs._elapsed_time_free;
+        _elapsed_time_realloc += rhs._elapsed_time_realloc;
+    }
+
     void clear() {
     _elapsed_time_malloc = {};
     _elapsed_time_free = {};
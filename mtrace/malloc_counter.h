@@ -28,6 +28,15 @@ struct malloc_counter
         _realloc_bytes += size;
     }
 
+    void merge(const malloc_counter& rhs)
+    {
+        _malloc_calls += rhs._malloc_calls;
+        _free_calls += rhs._free_calls;
+        _realloc_calls += rhs._realloc_calls;
+        _malloc_bytes += rhs._malloc_bytes;
+        _realloc_bytes += rhs._realloc_bytes;
+    }
+
 private:
     std::size_t _malloc_calls = {};
     std::size_t _free_calls = {};
@@ -21,4 +21,6 @@ struct malloc_printer
     {
         std::cout << "realloc " << size << " bytes from " << mem << " to " << new_mem << std::endl;
     }
+
+    void merge(const malloc_printer&) {}
 };
@@ -0,0 +1,133 @@
+#pragma once
+
+extern "C"
+{
+#include <malloc.h>
+}
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <vector>
+
+// Histogram of allocations per size class, i.e. per usable size of the block malloc
+// actually hands out, with the request sizes that fell into each class and how many
+// blocks of the class are still alive. Node-based containers show up as a few classes
+// with as many live blocks as elements: the sizes to configure node pools with.
+// Each allocation costs a couple of map lookups, so nothing is recorded until enable().
+struct malloc_sizes
+{
+    struct size_class
+    {
+        std::size_t allocs = {};
+        std::size_t frees = {};
+        std::map<std::size_t, std::size_t> requests; // request size -> allocations
+
+        // net over the traced interval: negative when it frees blocks allocated before, or
+        // per thread when another thread frees them
+        std::int64_t live() const { return std::int64_t(allocs) - std::int64_t(frees); }
+
+        void merge(const size_class& rhs)
+        {
+            allocs += rhs.allocs;
+            frees += rhs.frees;
+            for (auto&& r : rhs.requests)
+                requests[r.first] += r.second;
+        }
+    };
+
+    static void enable(bool on = true) { enabled_flag() = on; }
+    static bool enabled() { return enabled_flag(); }
+
+    const std::map<std::size_t, size_class>& classes() const { return _classes; }
+
+    void pre_malloc(size_t) {}
+    void post_malloc(size_t size, const void* mem)
+    {
+        allocated(size, mem);
+    }
+
+    void pre_free(const void* mem)
+    {
+        freed(mem);
+    }
+    void post_free(const void*) {}
+
+    // a realloc frees the old block and allocates the new one, unless it failed
+    void pre_realloc(const void* mem, size_t)
+    {
+        if (enabled())
+            _realloc_from = mem ? ::malloc_usable_size(const_cast<void*>(mem)) : 0;
+    }
+
+    void post_realloc(const void* mem, size_t size, const void* new_mem)
+    {
+        if (!enabled() || (!new_mem && size))
+            return;
+
+        if (mem)
+            ++_classes[_realloc_from].frees;
+        allocated(size, new_mem);
+    }
+
+    void merge(const malloc_sizes& rhs)
+    {
+        for (auto&& c : rhs._classes)
+            _classes[c.first].merge(c.second);
+    }
+
+    // the n size classes with the most allocations, then the most live blocks
+    void print_top(std::ostream& os, std::size_t n) const
+    {
+        std::vector<std::pair<std::size_t, const size_class*>> sorted;
+        for (auto&& c : _classes)
+            sorted.emplace_back(c.first, &c.second);
+
+        std::sort(sorted.begin(), sorted.end(), [](auto&& lhs, auto&& rhs)
+        {
+            return std::make_pair(lhs.second->allocs, lhs.second->live()) > std::make_pair(rhs.second->allocs, rhs.second->live());
+        });
+        sorted.resize(std::min(n, sorted.size()));
+
+        os << std::setw(10) << "class" << std::setw(12) << "allocs" << std::setw(12) << "frees" << std::setw(12) << "live" << "  requested sizes" << std::endl;
+        for (auto&& c : sorted)
+        {
+            os << std::setw(10) << c.first
+               << std::setw(12) << c.second->allocs
+               << std::setw(12) << c.second->frees
+               << std::setw(12) << c.second->live() << " ";
+
+            for (auto&& r : c.second->requests)
+                os << " " << r.first << "(" << r.second << ")";
+            os << std::endl;
+        }
+    }
+
+private:
+    static bool& enabled_flag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    void allocated(std::size_t size, const void* mem)
+    {
+        if (!enabled() || !mem)
+            return;
+
+        size_class& c = _classes[::malloc_usable_size(const_cast<void*>(mem))];
+        ++c.allocs;
+        ++c.requests[size];
+    }
+
+    void freed(const void* mem)
+    {
+        if (enabled() && mem)
+            ++_classes[::malloc_usable_size(const_cast<void*>(mem))].frees;
+    }
+
+    std::map<std::size_t, size_class> _classes; // usable size -> class
+    std::size_t _realloc_from = {};
+};
@@ -0,0 +1,154 @@
+#include "mtrace.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+// Interposes the C allocator of the executable it is linked into, forwarding to glibc's
+// implementation. The hooks are only called while an mtrace is alive, and never from
+// inside a hook: whatever a handler allocates goes straight to glibc.
+
+extern "C"
+{
+void* __libc_malloc(std::size_t);
+void* __libc_calloc(std::size_t, std::size_t);
+void* __libc_realloc(void*, std::size_t);
+void __libc_free(void*);
+void* __libc_memalign(std::size_t, std::size_t);
+}
+
+namespace
+{
+
+std::atomic<const detail::malloc_hooks*> g_hooks = {nullptr};
+thread_local bool t_in_hook = false;
+
+// the hooks to call on this thread, null when not tracing or already inside a hook
+inline const detail::malloc_hooks* enter()
+{
+    const detail::malloc_hooks* hooks = g_hooks.load(std::memory_order_acquire);
+    if (!hooks || t_in_hook)
+        return nullptr;
+
+    t_in_hook = true;
+    return hooks;
+}
+
+inline void leave()
+{
+    t_in_hook = false;
+}
+
+void* traced_malloc(std::size_t size, void* (*allocate)(std::size_t, std::size_t), std::size_t arg)
+{
+    const detail::malloc_hooks* hooks = enter();
+    if (!hooks)
+        return allocate(size, arg);
+
+    hooks->pre_malloc(size);
+    void* p = allocate(size, arg);
+    hooks->post_malloc(size, p);
+
+    leave();
+    return p;
+}
+
+void* plain_malloc(std::size_t size, std::size_t) { return __libc_malloc(size); }
+void* plain_calloc(std::size_t size, std::size_t) { return __libc_calloc(1, size); }
+void* aligned_malloc(std::size_t size, std::size_t alignment) { return __libc_memalign(alignment, size); }
+
+}
+
+namespace detail
+{
+
+const malloc_hooks* exchange_malloc_hooks(const malloc_hooks* hooks)
+{
+    return g_hooks.exchange(hooks, std::memory_order_acq_rel);
+}
+
+bool pause_tracing()
+{
+    const bool paused = t_in_hook;
+    t_in_hook = true;
+    return paused;
+}
+
+void resume_tracing(bool paused)
+{
+    t_in_hook = paused;
+}
+
+}
+
+extern "C"
+{
+
+void* malloc(std::size_t size)
+{
+    return traced_malloc(size, plain_malloc, 0);
+}
+
+void* calloc(std::size_t n, std::size_t size)
+{
+    std::size_t total;
+    if (__builtin_mul_overflow(n, size, &total))
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    return traced_malloc(total, plain_calloc, 0);
+}
+
+void* realloc(void* mem, std::size_t size)
+{
+    const detail::malloc_hooks* hooks = enter();
+    if (!hooks)
+        return __libc_realloc(mem, size);
+
+    hooks->pre_realloc(mem, size);
+    void* p = __libc_realloc(mem, size);
+    hooks->post_realloc(mem, size, p);
+
+    leave();
+    return p;
+}
+
+void free(void* mem)
+{
+    const detail::malloc_hooks* hooks = mem ? enter() : nullptr;
+    if (!hooks)
+        return __libc_free(mem);
+
+    hooks->pre_free(mem);
+    __libc_free(mem);
+    hooks->post_free(mem);
+
+    leave();
+}
+
+void* memalign(std::size_t alignment, std::size_t size)
+{
+    return traced_malloc(size, aligned_malloc, alignment);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    return traced_malloc(size, aligned_malloc, alignment);
+}
+
+int posix_memalign(void** out, std::size_t alignment, std::size_t size)
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void* p = traced_malloc(size, aligned_malloc, alignment);
+    if (!p)
+        return ENOMEM;
+
+    *out = p;
+    return 0;
+}
+
+}
@@ -1,141 +1,249 @@
 #pragma once
 
+#include "../tuple_for_each.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
 #include <tuple>
 #include <utility>
-
-extern "C"
-{
-#include <malloc.h>
-}
-
-namespace
-{
-    using malloc_hook = void*(*)(size_t, const void*);
-    using free_hook = void(*)(void*, const void*);
-    using realloc_hook = void*(*)(void*, size_t, const void*);
-}
+#include <vector>
+
+// Allocation tracing. mtrace.cc, which must be linked into the executable, interposes
+// malloc/calloc/realloc/free and the memalign family (operator new/delete end up there
+// too) and forwards every call to the active set of hooks, if any.
+//
+// An mtrace<Handlers...> installs its hooks for its lifetime. Every thread accumulates into
+// its own tuple of Handlers, so tracing does not add any shared write to the allocator;
+// get<I>() merges the tuples of all the threads that allocated. Each tuple has a lock of its
+// own, taken by its thread around every hook and by get() and clear(), so it is only ever
+// contended while being merged or cleared.
+//
+// Only one mtrace of a given type may be alive at a time: they would share the tuples, and
+// the inner one would clear what the outer one counted.
+//
+// Handlers provide pre/post_malloc, pre/post_free, pre/post_realloc and merge(const Handler&);
+// they run with tracing disabled on the calling thread, so they may allocate.
 
 namespace detail
 {
-    template<typename T, typename F, std::size_t... Is>
-    void for_each(T&& t, F f, std::integer_sequence<std::size_t, Is...>)
+    struct malloc_hooks
     {
-        auto l = { (f(std::get<Is>(t)), 0)... };
-    }
+        void (*pre_malloc)(std::size_t);
+        void (*post_malloc)(std::size_t, const void*);
+        void (*pre_free)(const void*);
+        void (*post_free)(const void*);
+        void (*pre_realloc)(const void*, std::size_t);
+        void (*post_realloc)(const void*, std::size_t, const void*);
+    };
+
+    // installs hooks (nullptr to disable tracing) and returns the previous ones, see mtrace.cc
+    const malloc_hooks* exchange_malloc_hooks(const malloc_hooks* hooks);
+
+    // disables tracing on the calling thread, returns whether it already was
+    bool pause_tracing();
+    void resume_tracing(bool paused);
+
+    // allocations of the calling thread are not traced within its scope
+    struct untraced_scope
+    {
+        untraced_scope() : _paused(pause_tracing()) {}
+        ~untraced_scope() { resume_tracing(_paused); }
 
-    template<typename... Ts, typename F>
-    void for_each_in_tuple(std::tuple<Ts...>& t, F f)
+        untraced_scope(const untraced_scope&) =delete;
+        untraced_scope& operator=(const untraced_scope&) =delete;
+
+    private:
+        bool _paused;
+    };
+
+    template<typename... Ts, std::size_t... Is>
+    void merge_tuples(std::tuple<Ts...>& to, const std::tuple<Ts...>& from, std::integer_sequence<std::size_t, Is...>)
     {
-        detail::for_each(t, f, std::make_index_sequence<sizeof...(Ts)>{});
+        auto l = { (std::get<Is>(to).merge(std::get<Is>(from)), 0)... };
+        (void)l;
     }
 }
 
 template <typename... Handlers>
 struct mtrace
 {
+    using handlers_type = std::tuple<Handlers...>;
+
     mtrace()
     {
-        save_hooks();
-        load_custom_hooks();
+        if (active().exchange(true))
+            throw std::logic_error("mtrace: an mtrace of the same type is already alive");
+
+        clear();
+        _previous = detail::exchange_malloc_hooks(&_hooks);
     }
 
     ~mtrace()
     {
-        restore_hooks();
+        detail::exchange_malloc_hooks(_previous);
+        active() = false;
     }
 
+    mtrace(const mtrace&) =delete;
+    mtrace& operator=(const mtrace&) =delete;
+
+    // handler I merged over all the threads
     template <std::size_t I>
-    auto& get()
+    auto get() const
     {
-        return std::get<I>(_handlers);
+        detail::untraced_scope untraced;
+        return std::get<I>(merged());
     }
 
-    template <std::size_t I>
-    const auto& get() const
+    // handlers may allocate while merging: the calling thread must not trace into its own
+    // tuple while it is being read
+    handlers_type merged() const
     {
-        return std::get<I>(_handlers);
+        detail::untraced_scope untraced;
+        handlers_type result;
+
+        auto& r = threads();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        detail::merge_tuples(result, r.retired, std::index_sequence_for<Handlers...>{});
+        for (auto&& local : r.locals)
+        {
+            std::lock_guard<std::mutex> local_lock(local->mutex);
+            detail::merge_tuples(result, local->handlers, std::index_sequence_for<Handlers...>{});
+        }
+
+        return result;
     }
 
-    static void* malloc(size_t size, const void* caller)
+    // starts over, e.g. between two phases traced by the same mtrace
+    void clear()
     {
-        restore_hooks();
+        detail::untraced_scope untraced;
+        auto& r = threads();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.retired = handlers_type();
+        for (auto&& local : r.locals)
+        {
+            std::lock_guard<std::mutex> local_lock(local->mutex);
+            local->handlers = handlers_type();
+        }
+    }
 
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.pre_malloc(size); });
-        void* p = ::malloc(size);
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.post_malloc(size, p); });
+private:
+    struct thread_handlers;
 
-        save_hooks();
-        load_custom_hooks();
-        return p;
+    // the tuples of the live threads that allocated under such an mtrace, and what the ones
+    // which exited had accumulated, so that threads coming and going do not pile up tuples
+    struct registry
+    {
+        std::mutex mutex;
+        std::vector<thread_handlers*> locals;
+        handlers_type retired;
+    };
+
+    static registry& threads()
+    {
+        static registry r;
+        return r;
     }
 
-    static void free(void* mem, const void* caller)
+    static std::atomic<bool>& active()
     {
-        restore_hooks();
+        static std::atomic<bool> a{false};
+        return a;
+    }
 
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.pre_free(mem); });
-        ::free(mem);
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.post_free(mem); });
+    // the tuple of the calling thread, folded into the registry's retired one at thread exit;
+    // the registry lock alone covers it there, as other threads only reach it under that lock
+    struct thread_handlers
+    {
+        explicit thread_handlers(bool& exited) :
+            _exited(exited)
+        {
+            auto& r = threads();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.locals.push_back(this);
+        }
+
+        ~thread_handlers()
+        {
+            detail::untraced_scope untraced;
+            auto& r = threads();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            detail::merge_tuples(r.retired, handlers, std::index_sequence_for<Handlers...>{});
+            r.locals.erase(std::find(r.locals.begin(), r.locals.end(), this));
+            _exited = true;
+        }
+
+        thread_handlers(const thread_handlers&) =delete;
+        thread_handlers& operator=(const thread_handlers&) =delete;
+
+        std::mutex mutex;
+        handlers_type handlers;
+
+    private:
+        bool& _exited;
+    };
+
+    // null once the calling thread's tuple is retired: whatever it frees while its other
+    // thread_locals are destroyed is not traced
+    static thread_handlers* local()
+    {
+        static thread_local bool t_exited = false;
+        if (t_exited)
+            return nullptr;
 
-        save_hooks();
-        load_custom_hooks();
+        static thread_local thread_handlers t_local(t_exited);
+        return &t_local;
     }
 
-    static void* realloc(void* mem, size_t size, const void* caller)
+    template <typename F>
+    static void for_each_handler(F f)
     {
-        restore_hooks();
+        if (thread_handlers* l = local())
+        {
+            std::lock_guard<std::mutex> lock(l->mutex);
+            detail::for_each_in_tuple(l->handlers, f);
+        }
+    }
 
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.pre_realloc(mem, size); });
-        void* p = ::realloc(mem, size);
-        detail::for_each_in_tuple(_handlers, [&](auto& x) { x.post_realloc(mem, size, p); });
+    static void pre_malloc(std::size_t size)
+    {
+        for_each_handler([&](auto& x) { x.pre_malloc(size); });
+    }
 
-        save_hooks();
-        load_custom_hooks();
-        return p;
+    static void post_malloc(std::size_t size, const void* p)
+    {
+        for_each_handler([&](auto& x) { x.post_malloc(size, p); });
     }
 
-private:
-    static void load_custom_hooks()
+    static void pre_free(const void* mem)
     {
-        __malloc_hook = malloc;
-        __free_hook = free;
-        __realloc_hook = realloc;
+        for_each_handler([&](auto& x) { x.pre_free(mem); });
     }
 
-    static void save_hooks()
+    static void post_free(const void* mem)
     {
-        _old_malloc = __malloc_hook;
-        _old_free = __free_hook;
-        _old_realloc = __realloc_hook;
+        for_each_handler([&](auto& x) { x.post_free(mem); });
     }
 
-    static void restore_hooks()
+    static void pre_realloc(const void* mem, std::size_t size)
     {
-        __malloc_hook = _old_malloc;
-        __free_hook = _old_free;
-        __realloc_hook = _old_realloc;
+        for_each_handler([&](auto& x) { x.pre_realloc(mem, size); });
     }
 
-    static malloc_hook  _old_malloc;
-    static free_hook    _old_free;
-    static realloc_hook _old_realloc;
+    static void post_realloc(const void* mem, std::size_t size, const void* p)
+    {
+        for_each_handler([&](auto& x) { x.post_realloc(mem, size, p); });
+    }
 
-    static std::tuple<Handlers...> _handlers;
+    static constexpr detail::malloc_hooks _hooks = {
+        pre_malloc, post_malloc, pre_free, post_free, pre_realloc, post_realloc
+    };
 
-    template <std::size_t I, typename... Ts>
-    friend auto& std::get(const mtrace<Ts...>&);
+    const detail::malloc_hooks* _previous;
 };
 
-template <typename... Handlers> malloc_hook mtrace<Handlers...>::_old_malloc;
-template <typename... Handlers> free_hook mtrace<Handlers...>::_old_free;
-template <typename... Handlers> realloc_hook mtrace<Handlers...>::_old_realloc;
-template <typename... Handlers> std::tuple<Handlers...> mtrace<Handlers...>::_handlers;
-
-namespace std
-{
-    template<size_t I, typename... Handlers>
-    auto& get(const mtrace<Handlers...>& mt)
-    {
-        return std::get<I>(mt._handlers);
-    }
-}
+template <typename... Handlers> constexpr detail::malloc_hooks mtrace<Handlers...>::_hooks;
@@ -0,0 +1,165 @@
+#pragma once
+
+extern "C"
+{
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <ostream>
+#include <string>
+
+// Hardware counters of the calling thread, user space only, between start() and stop().
+// Every counter is opened on its own, so those the CPU, the kernel (perf_event_paranoid)
+// or a virtual machine do not provide are simply reported as unavailable; when the kernel
+// multiplexes them, the values are scaled to the whole interval.
+class perf_counters
+{
+public:
+    enum counter
+    {
+        cycles,
+        instructions,
+        l1d_misses,
+        llc_misses,
+        dtlb_misses,
+        branch_misses,
+        Count
+    };
+
+    perf_counters()
+    {
+        for (int c = 0; c < Count; ++c)
+            _fds[c] = open(static_cast<counter>(c));
+
+        if (!available())
+        {
+            static bool warned = false;
+            if (!warned)
+                std::cerr << "perf counters unavailable, see /proc/sys/kernel/perf_event_paranoid" << std::endl;
+            warned = true;
+        }
+    }
+
+    ~perf_counters()
+    {
+        for (int fd : _fds)
+            if (fd != -1)
+                ::close(fd);
+    }
+
+    perf_counters(const perf_counters&) =delete;
+    perf_counters& operator=(const perf_counters&) =delete;
+
+    bool available() const
+    {
+        for (int fd : _fds)
+            if (fd != -1)
+                return true;
+        return false;
+    }
+
+    bool available(counter c) const { return _fds[c] != -1; }
+
+    void start()
+    {
+        for (int fd : _fds)
+            if (fd != -1)
+            {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+    }
+
+    void stop()
+    {
+        for (int fd : _fds)
+            if (fd != -1)
+                ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (int c = 0; c < Count; ++c)
+            _values[c] = read(_fds[c]);
+    }
+
+    // as of the last stop(), 0 when unavailable
+    std::uint64_t value(counter c) const { return _values[c]; }
+
+    static const char* name(counter c)
+    {
+        static const char* names[] = { "cycles", "instructions", "L1d_misses", "LLC_misses", "dTLB_misses", "branch_misses" };
+        return names[c];
+    }
+
+    // per iteration, nothing when no counter is available
+    void print(std::ostream& os, const std::string& desc, std::size_t iterations) const
+    {
+        if (!available())
+            return;
+
+        const double n = iterations ? double(iterations) : 1.0;
+
+        os << desc << ":";
+        for (int c = 0; c < Count; ++c)
+        {
+            os << " " << name(static_cast<counter>(c)) << "=";
+            if (available(static_cast<counter>(c)))
+                os << _values[c] / n;
+            else
+                os << "n/a";
+        }
+
+        if (available(cycles) && available(instructions) && _values[cycles])
+            os << " IPC=" << double(_values[instructions]) / _values[cycles];
+        os << std::endl;
+    }
+
+private:
+    static int open(counter c)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        auto cache_miss = [](std::uint64_t cache)
+        {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+
+        switch (c)
+        {
+        case cycles:        attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case instructions:  attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case l1d_misses:    attr.type = PERF_TYPE_HW_CACHE; attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D); break;
+        case llc_misses:    attr.type = PERF_TYPE_HW_CACHE; attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL); break;
+        case dtlb_misses:   attr.type = PERF_TYPE_HW_CACHE; attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB); break;
+        case branch_misses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        default:            return -1;
+        }
+
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    static std::uint64_t read(int fd)
+    {
+        if (fd == -1)
+            return 0;
+
+        std::uint64_t values[3]; // value, time enabled, time running
+        if (::read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+            return 0;
+
+        return values[2] < values[1] ? std::uint64_t(double(values[0]) * values[1] / values[2]) : values[0];
+    }
+
+    int _fds[Count];
+    std::uint64_t _values[Count] = {};
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/random_access_index.hpp>
+#include <boost/multi_index/ranked_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/mpl/at.hpp>
+#include <boost/mpl/size.hpp>
+
+extern "C"
+{
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// Memory layout of a boost::multi_index_container configuration, without building one:
+// the node (value, links of every index, padding) comes from the node types themselves,
+// the size of an index's links as the growth of the node when the index is appended to
+// the ones before it. Hashed bucket arrays and random_access pointer arrays are replayed
+// with Boost's growth policies up to the element count, and every block is rounded as
+// glibc malloc rounds it. Allocations made by the elements themselves are not included.
+
+namespace detail
+{
+
+// bytes malloc hands out for a request: 16 byte chunks with an 8 byte header and a 24 byte
+// minimum, then whole pages once above the mmap threshold
+inline std::size_t malloc_block(std::size_t n)
+{
+    static const std::size_t MmapThreshold = 128 * 1024;
+    static const std::size_t PageSize = ::sysconf(_SC_PAGESIZE);
+
+    if (n + 8 >= MmapThreshold)
+        return (n + 16 + PageSize - 1) / PageSize * PageSize - 16;
+    return std::max<std::size_t>(32, (n + 8 + 15) / 16 * 16) - 8;
+}
+
+// bucket array sizes are protected in Boost
+struct bucket_sizes : boost::multi_index::detail::bucket_array_base<>
+{
+    static std::size_t at_least(std::size_t n) { return sizes[size_index(n)]; }
+};
+
+struct index_kind
+{
+    const char* name;
+    std::size_t links;      // pointers and counters in the node, before padding
+    bool buckets;
+    bool pointers;
+};
+
+template <typename Spec>
+struct index_kind_of
+{
+    static index_kind get() { return {"unknown", 0, false, false}; }
+};
+
+#define NODE_LAYOUT_INDEX_KIND(Specifier, Links, Buckets, Pointers)                 \
+template <typename... Args>                                                         \
+struct index_kind_of<boost::multi_index::Specifier<Args...>>                        \
+{                                                                                   \
+    static index_kind get() { return {#Specifier, Links, Buckets, Pointers}; }     \
+};
+
+NODE_LAYOUT_INDEX_KIND(ordered_unique, 3 * sizeof(void*), false, false)
+NODE_LAYOUT_INDEX_KIND(ordered_non_unique, 3 * sizeof(void*), false, false)
+NODE_LAYOUT_INDEX_KIND(ranked_unique, 3 * sizeof(void*) + sizeof(std::size_t), false, false)
+NODE_LAYOUT_INDEX_KIND(ranked_non_unique, 3 * sizeof(void*) + sizeof(std::size_t), false, false)
+NODE_LAYOUT_INDEX_KIND(hashed_unique, 2 * sizeof(void*), true, false)
+NODE_LAYOUT_INDEX_KIND(hashed_non_unique, 2 * sizeof(void*), true, false)
+NODE_LAYOUT_INDEX_KIND(sequenced, 2 * sizeof(void*), false, false)
+NODE_LAYOUT_INDEX_KIND(random_access, sizeof(void*), false, true)
+
+#undef NODE_LAYOUT_INDEX_KIND
+
+// the container with only the first N indexes
+template <typename Container, typename Seq>
+struct prefix_container;
+
+template <typename Container, std::size_t... Is>
+struct prefix_container<Container, std::index_sequence<Is...>>
+{
+    using type = boost::multi_index_container<
+        typename Container::value_type,
+        boost::multi_index::indexed_by<typename boost::mpl::at_c<typename Container::index_specifier_type_list, Is>::type...>,
+        typename Container::allocator_type
+    >;
+};
+
+template <typename Container, std::size_t N>
+std::size_t prefix_node_size()
+{
+    return sizeof(typename prefix_container<Container, std::make_index_sequence<N>>::type::final_node_type);
+}
+
+template <typename Container, std::size_t... Is>
+std::vector<std::size_t> node_sizes(std::index_sequence<Is...>)
+{
+    return { sizeof(typename Container::value_type), prefix_node_size<Container, Is + 1>()... };
+}
+
+template <typename Container, std::size_t... Is>
+std::vector<index_kind> index_kinds(std::index_sequence<Is...>)
+{
+    return { index_kind_of<typename boost::mpl::at_c<typename Container::index_specifier_type_list, Is>::type>::get()... };
+}
+
+// a growing array: the blocks it went through and the one it ends with
+struct array_growth
+{
+    std::size_t allocations = {};
+    std::size_t final_bytes = {};
+    std::size_t peak_bytes = {};    // everything alive during the last growth
+};
+
+// hashed indexes start with 53 buckets and rehash to the next prime above size / mlf + 1
+// when the size goes past bucket_count * mlf; a rehash also allocates two scratch arrays
+// of a hash and a node pointer per element
+inline array_growth bucket_growth(std::size_t elements, float mlf = 1.0f)
+{
+    array_growth g;
+    std::size_t buckets = bucket_sizes::at_least(0);
+    std::size_t previous = 0;
+    std::size_t rehashed = 0;
+    g.allocations = 1;
+
+    while (elements > std::size_t(float(buckets) * mlf))
+    {
+        rehashed = std::size_t(float(buckets) * mlf);
+        previous = buckets;
+        buckets = bucket_sizes::at_least(std::size_t(1.0f + float(rehashed + 1) / mlf));
+        g.allocations += 3;
+    }
+
+    g.final_bytes = malloc_block((buckets + 1) * sizeof(void*));
+    g.peak_bytes = g.final_bytes;
+    if (previous)
+        g.peak_bytes += malloc_block((previous + 1) * sizeof(void*)) + malloc_block(rehashed * sizeof(std::size_t)) + malloc_block(rehashed * sizeof(void*));
+    return g;
+}
+
+// random_access pointer arrays grow to 15, then by half
+inline array_growth pointer_growth(std::size_t elements)
+{
+    array_growth g;
+    std::size_t capacity = 0;
+    std::size_t previous = 0;
+    g.allocations = 1;
+
+    while (elements > capacity)
+    {
+        previous = capacity;
+        capacity = capacity <= 10 ? 15 : capacity + capacity / 2;
+        ++g.allocations;
+    }
+
+    g.final_bytes = malloc_block((capacity + 1) * sizeof(void*));
+    g.peak_bytes = g.final_bytes + (g.allocations > 1 ? malloc_block((previous + 1) * sizeof(void*)) : 0);
+    return g;
+}
+
+}
+
+template <typename Container>
+struct node_layout
+{
+    static const std::size_t Indexes = boost::mpl::size<typename Container::index_specifier_type_list>::value;
+
+    struct index
+    {
+        detail::index_kind kind;
+        std::size_t bytes;      // growth of the node
+        std::size_t padding;
+    };
+
+    explicit node_layout(std::size_t elements) :
+        elements(elements)
+    {
+        const auto sizes = detail::node_sizes<Container>(std::make_index_sequence<Indexes>{});
+        const auto kinds = detail::index_kinds<Container>(std::make_index_sequence<Indexes>{});
+
+        value_size = sizes.front();
+        node_size = sizes.back();
+        node_block = detail::malloc_block(node_size);
+
+        for (std::size_t i = 0; i < Indexes; ++i)
+        {
+            const std::size_t bytes = sizes[i + 1] - sizes[i];
+            const std::size_t links = std::min(kinds[i].links ? kinds[i].links : bytes, bytes);
+            indexes.push_back(index{kinds[i], bytes, bytes - links});
+
+            if (kinds[i].buckets)
+                arrays.push_back(detail::bucket_growth(elements));
+            else if (kinds[i].pointers)
+                arrays.push_back(detail::pointer_growth(elements));
+            else
+                arrays.push_back(detail::array_growth{});
+        }
+    }
+
+    // the header is a node, allocated like the others
+    std::size_t blocks() const
+    {
+        std::size_t n = elements + 1;
+        for (auto&& a : arrays)
+            n += a.allocations ? 1 : 0;
+        return n;
+    }
+
+    std::size_t allocations() const
+    {
+        std::size_t n = elements + 1;
+        for (auto&& a : arrays)
+            n += a.allocations;
+        return n;
+    }
+
+    std::size_t bytes() const
+    {
+        std::size_t n = (elements + 1) * node_block;
+        for (auto&& a : arrays)
+            n += a.final_bytes;
+        return n;
+    }
+
+    // while the last array to grow holds both its old and new blocks
+    std::size_t peak_bytes() const
+    {
+        std::size_t extra = 0;
+        for (auto&& a : arrays)
+            extra = std::max(extra, a.peak_bytes - a.final_bytes);
+        return bytes() + extra;
+    }
+
+    void print(std::ostream& os) const
+    {
+        std::size_t links = 0, padding = 0;
+        for (auto&& i : indexes)
+        {
+            links += i.bytes - i.padding;
+            padding += i.padding;
+        }
+
+        os << "  value " << value_size << " bytes, node " << node_size << " bytes (links " << links
+           << ", padding " << padding << "), malloc block " << node_block << " bytes" << std::endl;
+
+        for (std::size_t i = 0; i < indexes.size(); ++i)
+        {
+            os << "    index " << std::setw(2) << i << "  " << std::left << std::setw(20) << indexes[i].kind.name << std::right
+               << " links " << std::setw(3) << indexes[i].bytes - indexes[i].padding << "  padding " << std::setw(3) << indexes[i].padding;
+            if (arrays[i].allocations)
+                os << "  " << (indexes[i].kind.buckets ? "buckets " : "pointers ") << arrays[i].final_bytes
+                   << " bytes after " << arrays[i].allocations << " allocations";
+            os << std::endl;
+        }
+
+        os << "  " << elements << " elements: " << bytes() << " bytes, " << double(bytes()) / std::max<std::size_t>(elements, 1)
+           << " bytes per element, peak " << peak_bytes() << " bytes" << std::endl;
+    }
+
+    std::size_t elements;
+    std::size_t value_size = {};
+    std::size_t node_size = {};
+    std::size_t node_block = {};
+    std::vector<index> indexes;
+    std::vector<detail::array_growth> arrays;
+};
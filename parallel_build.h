@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Runs f on every element of a tuple, the elements handed out to `threads` threads (the
+// calling one included) as they become free; returns once all of them are done, rethrowing
+// the first exception if any. Used to build the independent indexes of a container side by
+// side: f must only touch the index it is given, and what all indexes share read-only.
+
+namespace detail
+{
+
+template <typename Tuple, typename F, std::size_t... Is>
+std::vector<std::function<void()>> parallel_tasks(Tuple& t, F& f, std::index_sequence<Is...>)
+{
+    return { [&t, &f]() { f(std::get<Is>(t)); }... };
+}
+
+}
+
+template <typename Tuple, typename F>
+void parallel_for_each(Tuple& t, F f, std::size_t threads)
+{
+    auto tasks = detail::parallel_tasks(t, f, std::make_index_sequence<std::tuple_size<Tuple>::value>{});
+    threads = std::max<std::size_t>(1, std::min(threads, tasks.size()));
+
+    if (threads == 1)
+    {
+        for (auto&& task : tasks)
+            task();
+        return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::vector<std::exception_ptr> errors(threads);
+
+    auto worker = [&](std::size_t w)
+    {
+        try
+        {
+            for (std::size_t i = next++; i < tasks.size(); i = next++)
+                tasks[i]();
+        }
+        catch (...)
+        {
+            errors[w] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 1; w < threads; ++w)
+        workers.emplace_back(worker, w);
+    worker(0);
+
+    for (auto&& w : workers)
+        w.join();
+
+    for (auto&& e : errors)
+        if (e)
+            std::rethrow_exception(e);
+}
@@ -0,0 +1,91 @@
+#include "message_handler.h"
+#include "file_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Writes `lines` records built from the instruments of the reference file; the market
+// references are made unique by replacing everything but the country code with a counter.
+void generate_file(const std::string& reference, const std::string& filename, std::size_t lines)
+{
+    std::vector<std::pair<std::string, double>> instruments;
+    load_file(reference, [&](const std::string& ref, double price)
+    {
+        instruments.emplace_back(ref, price);
+    });
+
+    if (instruments.empty())
+        throw std::runtime_error("no instrument in " + reference);
+
+    std::ofstream ofs(filename);
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        const auto& instrument = instruments[i % instruments.size()];
+        ofs << "XEUR," << instrument.first.substr(0, 2) << std::setw(10) << std::setfill('0') << i
+            << ',' << instrument.second << '\n';
+    }
+
+    if (!ofs)
+        throw std::runtime_error("failed to write " + filename);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc > 5)
+    {
+        std::cerr << argv[0] << " <reference file> <synthetic file> [lines] [max threads]" << std::endl;
+        return 1;
+    }
+
+    const std::size_t lines = argc > 3 ? std::stoul(argv[3]) : 4000000;
+    const std::size_t max_threads = argc > 4 ? std::stoul(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+    generate_file(argv[1], argv[2], lines);
+    mapped_file file(argv[2]);
+
+    std::cout << "file: " << argv[2] << " --- lines: " << lines << " - bytes: " << file.size()
+              << " - hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    using shard = std::vector<stock>;
+
+    // powers of two, then max_threads itself when it is not one
+    for (std::size_t threads = 1; threads <= max_threads; threads = threads < max_threads ? std::min(2 * threads, max_threads) : threads + 1)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        auto shards = load_mapped_file_parallel<shard>(file, threads, [](shard& s, std::experimental::string_view ref, double price)
+        {
+            const std::string market_ref(ref.data(), ref.size());
+            s.emplace_back(market_ref, market_ref, price, 100);
+        });
+
+        auto loaded = std::chrono::steady_clock::now();
+
+        market_data_provider_swiss_string_view mdp;
+        std::size_t stocks = 0;
+        for (auto&& s : shards)
+        {
+            for (auto&& stock : s)
+                mdp.add_stock(stock);
+            stocks += s.size();
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        if (stocks != lines)
+            throw std::runtime_error("unexpected number of stocks: " + std::to_string(stocks));
+
+        std::cout << "threads: " << threads << " --- shards: " << shards.size()
+                  << " - parse+insert: " << std::chrono::duration_cast<std::chrono::milliseconds>(loaded - start).count() << "ms"
+                  << " - merge into " << mdp.name() << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(end - loaded).count() << "ms"
+                  << " - total: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Static minimal perfect hash table (CHD, "hash, displace and compress" without the
+// compression): keys are hashed once, spread over n / BucketLoad buckets, and each bucket
+// gets a displacement which moves all of its keys to free slots of an n-slot table.
+// A lookup is one hash of the key, one read in the displacement array and one key compare
+// against the only slot the key can be in.
+//
+// The key set is fixed by build(); adding elements means building a new table.
+template <typename Value, typename KeyFromValue, typename Hash = std::hash<typename KeyFromValue::result_type>, typename KeyEqual = std::equal_to<typename KeyFromValue::result_type>>
+class perfect_hash_table
+{
+public:
+    using key_type = typename KeyFromValue::result_type;
+    using value_type = Value;
+
+    static const std::size_t BucketLoad = 4;
+    static const std::uint32_t MaxDisplacement = 1 << 24;
+
+    std::size_t size() const { return _slots.size(); }
+    bool empty() const { return _slots.empty(); }
+
+    std::size_t memory_usage() const
+    {
+        return _slots.capacity() * sizeof(Value) + _displacements.capacity() * sizeof(std::uint32_t);
+    }
+
+    const Value* find(const key_type& k) const
+    {
+        if (_slots.empty())
+            return nullptr;
+
+        const std::uint64_t h = _hash(k);
+        const Value& v = _slots[position(h, _displacements[bucket(h)])];
+        return _eq(_key(v), k) ? &v : nullptr;
+    }
+
+    Value* find(const key_type& k)
+    {
+        return const_cast<Value*>(static_cast<const perfect_hash_table&>(*this).find(k));
+    }
+
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (const Value& v : _slots)
+            f(v);
+    }
+
+    // hands the elements back, leaving the table empty
+    std::vector<Value> extract()
+    {
+        std::vector<Value> values;
+        values.swap(_slots);
+        _displacements.clear();
+        return values;
+    }
+
+    // replaces the content of the table; when several elements have the same key only the
+    // first one is kept, as an insertion into a unique index would do
+    void build(std::vector<Value> values)
+    {
+        std::vector<std::uint64_t> hashes(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+            hashes[i] = _hash(_key(values[i]));
+
+        std::vector<std::uint32_t> unique = unique_keys(values, hashes);
+        const std::size_t n = unique.size();
+
+        _slots.clear();
+        _displacements.assign(std::max<std::size_t>(1, (n + BucketLoad - 1) / BucketLoad), 0);
+
+        // group keys per bucket, then place the largest buckets first while the table is empty
+        std::vector<std::vector<std::uint32_t>> buckets(_displacements.size());
+        for (std::uint32_t i : unique)
+            buckets[bucket(hashes[i])].push_back(i);
+
+        std::vector<std::uint32_t> order(buckets.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+        std::vector<std::uint32_t> slot_owner(n);
+        std::vector<bool> taken(n);
+        std::vector<std::size_t> positions;
+
+        for (std::uint32_t b : order)
+        {
+            const auto& keys = buckets[b];
+            if (keys.empty())
+                break;
+
+            std::uint32_t d = 0;
+            for (; d < MaxDisplacement; ++d)
+            {
+                positions.clear();
+                for (std::uint32_t i : keys)
+                {
+                    const std::size_t pos = position(hashes[i], d, n);
+                    if (taken[pos] || std::find(positions.begin(), positions.end(), pos) != positions.end())
+                        break;
+                    positions.push_back(pos);
+                }
+
+                if (positions.size() == keys.size())
+                    break;
+            }
+
+            if (d == MaxDisplacement)
+                throw std::runtime_error("perfect_hash_table: no displacement found");
+
+            _displacements[b] = d;
+            for (std::size_t j = 0; j < keys.size(); ++j)
+            {
+                taken[positions[j]] = true;
+                slot_owner[positions[j]] = keys[j];
+            }
+        }
+
+        _slots.reserve(n);
+        for (std::uint32_t i : slot_owner)
+            _slots.push_back(std::move(values[i]));
+    }
+
+private:
+    // returns the indexes of the first occurrence of every key; distinct keys sharing their
+    // full 64-bit hash cannot be separated by any displacement
+    std::vector<std::uint32_t> unique_keys(const std::vector<Value>& values, const std::vector<std::uint64_t>& hashes) const
+    {
+        std::vector<std::uint32_t> order(values.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs) { return hashes[lhs] < hashes[rhs]; });
+
+        std::vector<std::uint32_t> unique;
+        unique.reserve(values.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            if (i > 0 && hashes[order[i]] == hashes[order[i - 1]])
+            {
+                if (!_eq(_key(values[order[i]]), _key(values[order[i - 1]])))
+                    throw std::runtime_error("perfect_hash_table: 64-bit hash collision");
+                continue;
+            }
+
+            unique.push_back(order[i]);
+        }
+
+        std::sort(unique.begin(), unique.end());
+        return unique;
+    }
+
+    static std::uint64_t mix(std::uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // maps a 64-bit value to [0, n) with a multiplication instead of a division
+    static std::size_t reduce(std::uint64_t x, std::size_t n)
+    {
+        return static_cast<std::size_t>((static_cast<unsigned __int128>(x) * n) >> 64);
+    }
+
+    std::size_t bucket(std::uint64_t h) const
+    {
+        return reduce(mix(h), _displacements.size());
+    }
+
+    static std::size_t position(std::uint64_t h, std::uint32_t d, std::size_t n)
+    {
+        return reduce(mix(h + (std::uint64_t(d) + 1) * 0x9e3779b97f4a7c15ull), n);
+    }
+
+    std::size_t position(std::uint64_t h, std::uint32_t d) const
+    {
+        return position(h, d, _slots.size());
+    }
+
+    std::vector<Value> _slots;
+    std::vector<std::uint32_t> _displacements;
+
+    KeyFromValue _key;
+    Hash _hash;
+    KeyEqual _eq;
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// The node pools alive, so that the idle ones can give their chunks back between two
+// measurements of the heap; not thread-safe either.
+class node_pool_base
+{
+public:
+    // releases the chunks of every pool without live nodes, returns false if some pool
+    // still had live nodes and kept its chunks
+    static bool release_idle_pools()
+    {
+        bool all = true;
+        for (node_pool_base* p = pools(); p; p = p->_next_pool)
+            all = p->release_if_idle() && all;
+        return all;
+    }
+
+protected:
+    node_pool_base()
+    {
+        _next_pool = pools();
+        pools() = this;
+    }
+
+    ~node_pool_base()
+    {
+        node_pool_base** p = &pools();
+        while (*p != this)
+            p = &(*p)->_next_pool;
+        *p = _next_pool;
+    }
+
+    virtual bool release_if_idle() = 0;
+
+private:
+    static node_pool_base*& pools()
+    {
+        static node_pool_base* head = nullptr;
+        return head;
+    }
+
+    node_pool_base* _next_pool;
+};
+
+// Fixed-size node pool: memory is carved out of large chunks and recycled through
+// an intrusive free list, so a container inserting N nodes calls malloc N / nodes_per_chunk
+// times instead of N times. Not thread-safe, chunks are only released when the pool dies
+// or through node_pool_base::release_idle_pools().
+template <std::size_t Size, std::size_t Align>
+struct node_pool : public node_pool_base
+{
+    static const std::size_t ChunkSize = 1 << 20;
+
+    static node_pool& instance()
+    {
+        static node_pool pool;
+        return pool;
+    }
+
+    node_pool() =default;
+
+    ~node_pool()
+    {
+        release();
+    }
+
+    node_pool(const node_pool&) =delete;
+    node_pool& operator=(const node_pool&) =delete;
+
+    void* allocate()
+    {
+        if (!_free_list)
+            refill();
+
+        node* n = _free_list;
+        _free_list = n->next;
+        ++_live_nodes;
+        return n;
+    }
+
+    void deallocate(void* p)
+    {
+        node* n = static_cast<node*>(p);
+        n->next = _free_list;
+        _free_list = n;
+        --_live_nodes;
+    }
+
+    std::size_t chunk_count() const { return _chunk_count; }
+    std::size_t live_nodes() const { return _live_nodes; }
+
+    static constexpr std::size_t node_size() { return sizeof(node); }
+    static constexpr std::size_t nodes_per_chunk() { return (ChunkSize - sizeof(chunk)) / sizeof(node); }
+
+private:
+    bool release_if_idle() override
+    {
+        if (_live_nodes)
+            return false;
+
+        release();
+        return true;
+    }
+
+    void release()
+    {
+        while (_chunks)
+        {
+            chunk* next = _chunks->next;
+            ::operator delete(_chunks);
+            _chunks = next;
+        }
+        _free_list = nullptr;
+        _chunk_count = 0;
+    }
+
+    union node
+    {
+        node* next;
+        alignas(Align) unsigned char storage[Size];
+    };
+
+    struct alignas(node) chunk
+    {
+        chunk* next;
+    };
+
+    void refill()
+    {
+        static_assert(nodes_per_chunk() > 0, "node too large for the pool chunk size");
+
+        chunk* c = static_cast<chunk*>(::operator new(ChunkSize));
+        c->next = _chunks;
+        _chunks = c;
+        ++_chunk_count;
+
+        node* nodes = reinterpret_cast<node*>(c + 1);
+        for (std::size_t i = nodes_per_chunk(); i > 0; --i)
+        {
+            nodes[i - 1].next = _free_list;
+            _free_list = &nodes[i - 1];
+        }
+    }
+
+    node* _free_list = {};
+    chunk* _chunks = {};
+    std::size_t _chunk_count = {};
+    std::size_t _live_nodes = {};
+};
+
+// Stateless allocator serving single-object allocations (i.e. container nodes) from the
+// node_pool of sizeof(T); array allocations such as bucket arrays go to operator new.
+template <typename T>
+struct pool_allocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = pool_allocator<U>;
+    };
+
+    pool_allocator() =default;
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)
+            return static_cast<T*>(pool().allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if (n == 1)
+            pool().deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+    // T may still be incomplete when the allocator gets rebound, so the pool is only named here
+    static auto& pool() { return node_pool<sizeof(T), alignof(T)>::instance(); }
+};
+
+template <typename T, typename U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) { return false; }
@@ -0,0 +1,123 @@
+#include "message_handler.h"
+#include "file_loader.h"
+#include "mtrace/tsc_chrono.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const std::chrono::milliseconds Duration(1000);
+
+// One writer publishes trades on random stocks while `readers` threads snapshot random quotes.
+// Every quote is seeded and then traded with volume == price, so a reader seeing them differ
+// caught a torn read.
+void benchmark_readers(const std::vector<stock>& stocks, std::size_t readers)
+{
+    market_data_provider_seqlock mdp;
+    for (auto&& s : stocks)
+    {
+        mdp.add_stock(s);
+        mdp.on_trade(s.market_ref.data(), s.market_ref.size(), 0, 0);
+    }
+
+    std::atomic<bool> running{true};
+    std::vector<std::size_t> reads(readers);
+    std::vector<std::size_t> torn(readers);
+
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&, r]()
+        {
+            std::minstd_rand gen(r);
+            std::size_t n = 0, bad = 0;
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                const stock& s = stocks[gen() % stocks.size()];
+                const quote q = mdp.get_quote(s.market_ref.data(), s.market_ref.size());
+                bad += q.volume != static_cast<int>(q.price);
+                ++n;
+            }
+
+            reads[r] = n;
+            torn[r] = bad;
+        });
+    }
+
+    std::minstd_rand gen(readers);
+    std::uint64_t total_latency = 0;
+    std::uint64_t max_latency = 0;
+    std::size_t writes = 0;
+    tsc_chrono chrono;
+
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < Duration)
+    {
+        for (int i = 0; i < 1000; ++i, ++writes)
+        {
+            const stock& s = stocks[gen() % stocks.size()];
+            const int volume = static_cast<int>(writes % 100000);
+
+            chrono.start();
+            mdp.on_trade(s.market_ref.data(), s.market_ref.size(), volume, volume);
+            const std::uint64_t latency = chrono.elapsed();
+
+            total_latency += latency;
+            max_latency = std::max(max_latency, latency);
+        }
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    for (auto&& t : threads)
+        t.join();
+
+    auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::size_t total_reads = 0, total_torn = 0;
+    for (std::size_t r = 0; r < readers; ++r)
+    {
+        total_reads += reads[r];
+        total_torn += torn[r];
+    }
+
+    std::cout << "readers: " << readers << " --- " << mdp.name()
+              << " - reads/s: " << static_cast<std::uint64_t>(total_reads / seconds)
+              << " (" << static_cast<std::uint64_t>(total_reads / seconds / std::max<std::size_t>(readers, 1)) << " per reader)"
+              << " - torn reads: " << total_torn
+              << " - writes/s: " << static_cast<std::uint64_t>(writes / seconds)
+              << " - write latency avg: " << tsc_chrono::from_cycles(total_latency / std::max<std::size_t>(writes, 1)).count() << "ns"
+              << " max: " << tsc_chrono::from_cycles(max_latency).count() << "ns" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << argv[0] << " <filename> [max readers]" << std::endl;
+        return 1;
+    }
+
+    const std::size_t max_readers = argc == 3 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<stock> stocks;
+    load_file(argv[1], [&](const std::string& ref, double price)
+    {
+        stocks.emplace_back(ref, ref, price, 100);
+    });
+
+    if (stocks.empty())
+        throw std::runtime_error("no stock loaded");
+
+    tsc_chrono::init();
+
+    for (std::size_t readers = 1; readers <= max_readers; readers *= 2)
+        benchmark_readers(stocks, readers);
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "cache_aligned.h"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Read-copy-update wrapper around a container that is read on every request but rarely
+// modified. Readers look things up in an immutable snapshot without taking any lock;
+// writers copy the current version, apply a whole batch of changes to the copy and publish
+// it with a single pointer swap.
+//
+// Old versions are reclaimed by epochs: each reader announces the epoch it entered at in its
+// own slot, and a version retired at epoch E is freed once no reader is still inside an
+// epoch older than E.
+template <typename Container, std::size_t MaxReaders = 64>
+class rcu_table : public cache_aligned
+{
+    struct slot;
+
+public:
+    class reader;
+
+    // Pins the version current at construction; the container stays valid, and unchanged,
+    // until the snapshot is destroyed.
+    class snapshot
+    {
+    public:
+        snapshot(snapshot&& rhs) :
+            _slot(rhs._slot),
+            _version(rhs._version)
+        {
+            rhs._slot = nullptr;
+        }
+
+        ~snapshot()
+        {
+            if (_slot)
+                _slot->epoch.store(Quiescent, std::memory_order_release);
+        }
+
+        snapshot(const snapshot&) =delete;
+        snapshot& operator=(const snapshot&) =delete;
+
+        const Container& operator*() const { return *_version; }
+        const Container* operator->() const { return _version; }
+
+    private:
+        friend class reader;
+
+        snapshot(slot& s, const rcu_table& table) :
+            _slot(&s)
+        {
+            // the slot must be visible before the version is read, see publish()
+            s.epoch.store(table._epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            _version = table._current.load(std::memory_order_seq_cst);
+        }
+
+        slot* _slot;
+        const Container* _version;
+    };
+
+    // Owns one reader slot; not thread-safe, each reader thread gets its own, and it takes
+    // one snapshot at a time.
+    class reader
+    {
+    public:
+        reader(reader&& rhs) :
+            _table(rhs._table),
+            _slot(rhs._slot)
+        {
+            rhs._slot = nullptr;
+        }
+
+        ~reader()
+        {
+            if (_slot)
+                _slot->used.store(false, std::memory_order_release);
+        }
+
+        reader(const reader&) =delete;
+        reader& operator=(const reader&) =delete;
+
+        snapshot read() const { return snapshot(*_slot, *_table); }
+
+    private:
+        friend class rcu_table;
+
+        reader(const rcu_table& table, slot& s) :
+            _table(&table),
+            _slot(&s)
+        {}
+
+        const rcu_table* _table;
+        slot* _slot;
+    };
+
+    explicit rcu_table(Container initial = Container()) :
+        _current(new Container(std::move(initial)))
+    {}
+
+    // no reader may be alive anymore
+    ~rcu_table()
+    {
+        delete _current.load(std::memory_order_relaxed);
+    }
+
+    rcu_table(const rcu_table&) =delete;
+    rcu_table& operator=(const rcu_table&) =delete;
+
+    reader make_reader() const
+    {
+        for (auto&& s : _slots)
+        {
+            bool expected = false;
+            if (!s.used.load(std::memory_order_relaxed) && s.used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return reader(*this, s);
+        }
+
+        throw std::length_error("too many rcu_table readers");
+    }
+
+    // Applies f(Container&) to a copy of the current version and publishes it; writers are
+    // serialized, so batch as many changes as possible in one call.
+    template <typename Callable>
+    void update(Callable f)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+
+        std::unique_ptr<Container> next(new Container(*_current.load(std::memory_order_relaxed)));
+        f(*next);
+        publish(std::move(next));
+    }
+
+    // replaces the whole content at once
+    void assign(Container c)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        publish(std::unique_ptr<Container>(new Container(std::move(c))));
+    }
+
+    // versions published but not reclaimed yet, the current one excluded
+    std::size_t retired() const
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        return _retired.size();
+    }
+
+    // tries to free the retired versions again, e.g. once readers went idle
+    void reclaim()
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        reclaim_retired();
+    }
+
+private:
+    static const std::uint64_t Quiescent = 0;
+
+    struct alignas(CacheLineSize) slot
+    {
+        std::atomic<std::uint64_t> epoch = {Quiescent};
+        std::atomic<bool> used = {false};
+    };
+
+    struct retired_version
+    {
+        std::uint64_t epoch;
+        std::unique_ptr<const Container> version;
+    };
+
+    // A reader that announced an epoch >= the retire epoch read _epoch after the increment
+    // below, so after the swap, and can only have seen the new version.
+    void publish(std::unique_ptr<Container> next)
+    {
+        std::unique_ptr<const Container> previous(_current.exchange(next.release(), std::memory_order_seq_cst));
+        const std::uint64_t epoch = _epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        _retired.push_back(retired_version{epoch, std::move(previous)});
+        reclaim_retired();
+    }
+
+    void reclaim_retired()
+    {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+        for (auto&& s : _slots)
+        {
+            const std::uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+            if (e != Quiescent && e < oldest)
+                oldest = e;
+        }
+
+        auto it = _retired.begin();
+        for (; it != _retired.end() && it->epoch <= oldest; ++it)
+            ;
+        _retired.erase(_retired.begin(), it);
+    }
+
+    alignas(CacheLineSize) std::atomic<const Container*> _current;
+    std::atomic<std::uint64_t> _epoch = {1};
+
+    mutable std::mutex _writer;
+    std::vector<retired_version> _retired; // by increasing epoch
+
+    mutable slot _slots[MaxReaders];
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock around a small trivially copyable value. The writer makes the
+// sequence odd, writes, and makes it even again; readers copy the value and retry if the
+// sequence was odd or changed meanwhile. Readers never write to shared memory, so any number
+// of them can read without bouncing a cache line between cores.
+//
+// The value is kept as relaxed atomic words rather than a plain T, so that a reader racing
+// with the writer is not a data race, only a retry.
+template <typename T>
+class seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock needs a trivially copyable value");
+
+public:
+    seqlock() : seqlock(T{}) {}
+
+    explicit seqlock(const T& v)
+    {
+        store(v);
+    }
+
+    seqlock(const seqlock& rhs) : seqlock(rhs.load()) {}
+    seqlock& operator=(const seqlock&) =delete;
+
+    // single writer only
+    void store(const T& v)
+    {
+        std::uint64_t words[Words] = {};
+        std::memcpy(words, &v, sizeof(T));
+
+        const std::uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < Words; ++i)
+            _words[i].store(words[i], std::memory_order_relaxed);
+
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        std::uint64_t words[Words];
+        for (;;)
+        {
+            const std::uint32_t before = _seq.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                _mm_pause();
+                continue;
+            }
+
+            for (std::size_t i = 0; i < Words; ++i)
+                words[i] = _words[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T v;
+        std::memcpy(&v, words, sizeof(T));
+        return v;
+    }
+
+private:
+    static const std::size_t Words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    std::atomic<std::uint32_t> _seq = {0};
+    std::atomic<std::uint64_t> _words[Words];
+};
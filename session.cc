@@ -4,12 +4,18 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
+#include "rcu_table.h"
+
 #include <string>
 #include <chrono>
 #include <map>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <experimental/string_view>
 
 using namespace boost::multi_index;
@@ -138,12 +144,192 @@ void bla()
     > sessions;
 }
 
-int main()
+struct by_user_script{};
+struct by_id{};
+
+using session_table = boost::multi_index_container<
+  session,
+  indexed_by<
+    hashed_unique<
+      tag<by_name>,
+      member<session, std::string, &session::user_name>
+    >,
+    hashed_unique<
+      tag<by_user_script>,
+      composite_key<
+        session,
+        const_mem_fun<session, std::experimental::string_view, &session::user_name_view>,
+        const_mem_fun<session, std::experimental::string_view, &session::script_name_view>
+      >,
+      composite_key_hash<
+        std::hash<std::experimental::string_view>,
+        std::hash<std::experimental::string_view>
+      >
+    >,
+    hashed_non_unique<
+      tag<by_id>,
+      const_mem_fun<session, std::string, &session::id>
+    >
+  >
+>;
+
+static const std::size_t Sessions = 10000;
+static const std::size_t UpdateBatch = 16;
+static const std::chrono::milliseconds UpdatePeriod(1);
+static const std::chrono::milliseconds Duration(500);
+
+std::string user_of(std::size_t i) { return "user" + std::to_string(i); }
+std::string script_of(std::size_t i) { return "script" + std::to_string(i % 50) + ".py"; }
+
+// restarts a batch of random sessions
+void restart_sessions(session_table& sessions, std::minstd_rand& gen)
 {
+    for (std::size_t i = 0; i < UpdateBatch; ++i)
+    {
+        const std::size_t n = gen() % Sessions;
+        auto& v = sessions.get<by_name>();
+        v.erase(user_of(n));
+
+        session s(user_of(n), script_of(n));
+        s.started_time = std::chrono::system_clock::now();
+        sessions.insert(std::move(s));
+    }
+}
+
+// `readers` threads look sessions up by user and by user/script while the calling thread
+// restarts a batch of sessions every UpdatePeriod; lookup(gen) returns whether it found one
+template <typename Lookup, typename Update>
+void benchmark_concurrent_lookups(const char* name, std::size_t readers, Lookup lookup, Update update)
+{
+    std::atomic<bool> running{true};
+    std::vector<std::size_t> reads(readers);
+    std::vector<std::size_t> missed(readers);
+
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&, r]()
+        {
+            auto find = lookup();
+            std::minstd_rand gen(r + 1);
+            std::size_t n = 0, miss = 0;
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                miss += !find(gen);
+                ++n;
+            }
+
+            reads[r] = n;
+            missed[r] = miss;
+        });
+    }
+
+    std::minstd_rand gen(0);
+    std::size_t updates = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < Duration)
+    {
+        update(gen);
+        ++updates;
+        std::this_thread::sleep_for(UpdatePeriod);
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    for (auto&& t : threads)
+        t.join();
+
+    auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::size_t total_reads = 0, total_missed = 0;
+    for (std::size_t r = 0; r < readers; ++r)
+    {
+        total_reads += reads[r];
+        total_missed += missed[r];
+    }
+
+    std::cout << "readers: " << readers << " --- " << name
+              << " - lookups/s: " << static_cast<std::uint64_t>(total_reads / seconds)
+              << " (" << static_cast<std::uint64_t>(total_reads / seconds / readers) << " per reader)"
+              << " - missed: " << total_missed
+              << " - update batches: " << updates << std::endl;
+}
+
+void concurrent_lookups(std::size_t max_readers)
+{
+    session_table initial;
+    for (std::size_t i = 0; i < Sessions; ++i)
+        initial.insert({user_of(i), script_of(i)});
+
+    for (std::size_t readers = 1; readers <= max_readers; readers *= 2)
+    {
+        // a mutex-guarded table misses nothing: erase and insert happen under the same lock
+        session_table locked = initial;
+        std::mutex m;
+
+        benchmark_concurrent_lookups("mutex<mic>", readers,
+            [&]()
+            {
+                return [&](std::minstd_rand& gen)
+                {
+                    const std::size_t n = gen() % Sessions;
+                    const std::string user = user_of(n);
+                    const std::string script = script_of(n);
+
+                    std::lock_guard<std::mutex> lock(m);
+                    return locked.get<by_name>().count(user) + locked.get<by_user_script>().count(boost::make_tuple(user, script)) == 2;
+                };
+            },
+            [&](std::minstd_rand& gen)
+            {
+                std::lock_guard<std::mutex> lock(m);
+                restart_sessions(locked, gen);
+            });
+
+        // a snapshot holds whole batches, so readers miss nothing either
+        rcu_table<session_table> rcu(initial);
+
+        benchmark_concurrent_lookups("rcu<mic>", readers,
+            [&]()
+            {
+                return [reader = rcu.make_reader()](std::minstd_rand& gen)
+                {
+                    const std::size_t n = gen() % Sessions;
+                    const std::string user = user_of(n);
+                    const std::string script = script_of(n);
+
+                    auto sessions = reader.read();
+                    return sessions->get<by_name>().count(user) + sessions->get<by_user_script>().count(boost::make_tuple(user, script)) == 2;
+                };
+            },
+            [&](std::minstd_rand& gen)
+            {
+                rcu.update([&](session_table& sessions) { restart_sessions(sessions, gen); });
+            });
+
+        // readers are gone, every old version must be reclaimable now
+        rcu.reclaim();
+        std::cout << "readers: " << readers << " --- rcu<mic> versions not reclaimed: " << rcu.retired() << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2)
+    {
+        std::cerr << argv[0] << " [max readers]" << std::endl;
+        return 1;
+    }
+
     map_multiple_index();
     simple_index();
     composed_index();
     function_index();
 
+    const std::size_t max_readers = argc == 2 ? std::stoul(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    concurrent_lookups(max_readers);
+
     return 0;
 }
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "cache_aligned.h"
+#include "message_handler.h"
+#include "spsc_queue.h"
+#include "tick.h"
+
+extern "C"
+{
+#include <pthread.h>
+#include <sched.h>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <experimental/string_view>
+
+// Pins the calling thread to the cpu-th CPU (modulo their number) of those the process may
+// run on; called first thing in a thread, so that whatever it allocates is touched there.
+inline void pin_to_cpu(std::size_t cpu)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        throw std::system_error(errno, std::generic_category(), "sched_getaffinity");
+
+    const std::size_t n = std::max(1, CPU_COUNT(&allowed));
+    std::size_t nth = cpu % n;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+    {
+        if (!CPU_ISSET(c, &allowed) || nth--)
+            continue;
+
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(c, &one);
+        if (int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(one), &one))
+            throw std::system_error(err, std::generic_category(), "pthread_setaffinity_np");
+        return;
+    }
+}
+
+// Partitions the stocks by hash of market_ref over N shards, each one a MarketDataProvider
+// owned by a single writer thread pinned to its own core (shard s on the s-th allowed CPU):
+// nothing in a shard is ever written by another thread, so the providers need no
+// synchronization at all.
+//
+// Feed threads send updates through a router; there is one SPSC queue per (producer, shard)
+// pair, so any number of feed threads can publish without contending with each other.
+// Stocks are handed to the writer threads at start(), which build their provider themselves
+// so that its memory is allocated (and first touched) by the thread that uses it.
+template <typename MarketDataProvider, std::size_t QueueCapacity = (1 << 12)>
+class sharded_market_data_provider
+{
+public:
+    static const std::size_t CacheLineSize = cache_aligned::CacheLineSize;
+    static const std::size_t BatchSize = 16;
+
+    using queue_type = spsc_queue<tick, QueueCapacity>;
+
+    // Routes the updates of one feed thread, batching them per shard; not thread-safe, each
+    // feed thread gets its own.
+    class router
+    {
+    public:
+        void on_price_change(const char* market_ref, int len, double new_price)
+        {
+            const std::size_t s = _owner->shard_of(market_ref, len);
+            auto& pending = _pending[s];
+
+            pending.batch[pending.size++] = tick(market_ref, len, new_price);
+            if (pending.size == BatchSize)
+                flush(s);
+        }
+
+        void flush()
+        {
+            for (std::size_t s = 0; s < _pending.size(); ++s)
+                flush(s);
+        }
+
+    private:
+        friend class sharded_market_data_provider;
+
+        struct pending_batch
+        {
+            tick batch[BatchSize];
+            std::size_t size = {};
+        };
+
+        router(sharded_market_data_provider& owner, std::size_t producer) :
+            _owner(&owner),
+            _producer(producer),
+            _pending(owner.shards())
+        {}
+
+        void flush(std::size_t s)
+        {
+            auto& pending = _pending[s];
+            auto& queue = _owner->queue(_producer, s);
+
+            for (std::size_t pushed = 0; pushed < pending.size; )
+            {
+                const std::size_t n = queue.try_push(pending.batch + pushed, pending.batch + pending.size);
+                if (n == 0)
+                    std::this_thread::yield();
+                pushed += n;
+            }
+            pending.size = 0;
+        }
+
+        sharded_market_data_provider* _owner;
+        std::size_t _producer;
+        std::vector<pending_batch> _pending;
+    };
+
+    sharded_market_data_provider(std::size_t shards, std::size_t producers)
+    {
+        if (shards == 0 || producers == 0)
+            throw std::invalid_argument("sharded_market_data_provider needs at least one shard and one producer");
+
+        _shards.reserve(shards);
+        for (std::size_t s = 0; s < shards; ++s)
+            _shards.push_back(std::make_unique<shard>(producers));
+    }
+
+    ~sharded_market_data_provider()
+    {
+        stop();
+    }
+
+    sharded_market_data_provider(const sharded_market_data_provider&) =delete;
+    sharded_market_data_provider& operator=(const sharded_market_data_provider&) =delete;
+
+    static std::string name() { return std::string("sharded<") + MarketDataProvider::name() + ">"; }
+
+    std::size_t shards() const { return _shards.size(); }
+    std::size_t producers() const { return _shards.front()->inbound.size(); }
+
+    std::size_t shard_of(const char* market_ref, int len) const
+    {
+        return std::hash<std::experimental::string_view>()(std::experimental::string_view(market_ref, len)) % _shards.size();
+    }
+
+    // before start() only
+    void add_stock(const stock& s)
+    {
+        _shards[shard_of(s.market_ref.data(), s.market_ref.size())]->initial_stocks.push_back(s);
+    }
+
+    router make_router(std::size_t producer)
+    {
+        if (producer >= producers())
+            throw std::out_of_range("no such producer");
+        return router(*this, producer);
+    }
+
+    // launches the writer threads, returns once every shard has built its provider; if one
+    // of them failed to, stops all of them and rethrows its exception
+    void start()
+    {
+        for (std::size_t i = 0; i < _shards.size(); ++i)
+        {
+            auto& s = *_shards[i];
+            s.writer = std::thread([this, &s, i]() { run(s, i); });
+        }
+
+        for (auto&& s : _shards)
+            while (!s->ready.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+        for (auto&& s : _shards)
+        {
+            if (s->error)
+            {
+                stop();
+                std::rethrow_exception(s->error);
+            }
+        }
+    }
+
+    // drains the queues and joins the writer threads; routers must have been flushed
+    void stop()
+    {
+        _stopping.store(true, std::memory_order_release);
+        for (auto&& s : _shards)
+            if (s->writer.joinable())
+                s->writer.join();
+    }
+
+    std::size_t applied() const
+    {
+        std::size_t n = 0;
+        for (auto&& s : _shards)
+            n += s->applied.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    struct alignas(CacheLineSize) shard : cache_aligned
+    {
+        explicit shard(std::size_t producers)
+        {
+            inbound.reserve(producers);
+            for (std::size_t p = 0; p < producers; ++p)
+                inbound.push_back(std::make_unique<queue_type>());
+        }
+
+        std::unique_ptr<MarketDataProvider> provider;
+        std::vector<stock> initial_stocks;
+        std::vector<std::unique_ptr<queue_type>> inbound; // one per producer
+
+        std::thread writer;
+        std::exception_ptr error; // set before ready if the provider could not be built
+        std::atomic<bool> ready = {false};
+        std::atomic<std::size_t> applied = {0};
+    };
+
+    queue_type& queue(std::size_t producer, std::size_t s)
+    {
+        return *_shards[s]->inbound[producer];
+    }
+
+    void run(shard& s, std::size_t cpu)
+    {
+        try
+        {
+            pin_to_cpu(cpu);
+
+            s.provider = std::make_unique<MarketDataProvider>();
+            for (auto&& stock : s.initial_stocks)
+                s.provider->add_stock(stock);
+            finish_load(*s.provider, 0);
+            std::vector<stock>().swap(s.initial_stocks);
+        }
+        catch (...)
+        {
+            s.error = std::current_exception();
+            s.ready.store(true, std::memory_order_release);
+            return;
+        }
+
+        s.ready.store(true, std::memory_order_release);
+
+        tick batch[BatchSize];
+        for (;;)
+        {
+            // read the flag first: if it was set, whatever was pushed before is visible below
+            const bool stopping = _stopping.load(std::memory_order_acquire);
+
+            std::size_t popped = 0;
+            for (auto&& queue : s.inbound)
+            {
+                const std::size_t n = queue->try_pop(batch, BatchSize);
+                for (std::size_t i = 0; i < n; ++i)
+                    s.provider->on_price_change(batch[i].market_ref, batch[i].len, batch[i].price);
+                popped += n;
+            }
+
+            if (popped)
+                s.applied.store(s.applied.load(std::memory_order_relaxed) + popped, std::memory_order_relaxed);
+            else if (stopping)
+                break;
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    std::vector<std::unique_ptr<shard>> _shards;
+    std::atomic<bool> _stopping = {false};
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "cache_aligned.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer/single-consumer ring buffer. Each side owns its index on its own
+// cache line and keeps a cached copy of the other side's, so the shared line is only read
+// when the cached value says the queue looks full (producer) or empty (consumer).
+// Batched push/pop publish a whole batch with a single release store.
+template <typename T, std::size_t Capacity>
+class spsc_queue : public cache_aligned
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    spsc_queue() =default;
+
+    spsc_queue(const spsc_queue&) =delete;
+    spsc_queue& operator=(const spsc_queue&) =delete;
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+    // producer side
+
+    bool try_push(const T& v)
+    {
+        return try_push(&v, &v + 1) == 1;
+    }
+
+    // pushes as many elements of [first, last) as there is room for, returns how many
+    template <typename Iterator>
+    std::size_t try_push(Iterator first, Iterator last)
+    {
+        const std::size_t tail = _tail.load(std::memory_order_relaxed);
+        const std::size_t wanted = static_cast<std::size_t>(last - first);
+
+        if (Capacity - (tail - _cached_head) < wanted)
+            _cached_head = _head.load(std::memory_order_acquire);
+
+        std::size_t n = std::min(wanted, Capacity - (tail - _cached_head));
+        for (std::size_t i = 0; i < n; ++i, ++first)
+            _buffer[(tail + i) & (Capacity - 1)] = *first;
+
+        if (n)
+            _tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer side
+
+    bool try_pop(T& v)
+    {
+        return try_pop(&v, 1) == 1;
+    }
+
+    // pops up to max elements into out, returns how many
+    std::size_t try_pop(T* out, std::size_t max)
+    {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+
+        if (_cached_tail - head < max)
+            _cached_tail = _tail.load(std::memory_order_acquire);
+
+        std::size_t n = std::min(max, _cached_tail - head);
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = _buffer[(head + i) & (Capacity - 1)];
+
+        if (n)
+            _head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // approximate when called concurrently with the other side
+    std::size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(CacheLineSize) std::atomic<std::size_t> _head = {0};   // written by the consumer
+    std::size_t _cached_tail = {};                                 // consumer's view of _tail
+
+    alignas(CacheLineSize) std::atomic<std::size_t> _tail = {0};   // written by the producer
+    std::size_t _cached_head = {};                                 // producer's view of _head
+
+    alignas(CacheLineSize) std::array<T, Capacity> _buffer;
+};
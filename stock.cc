@@ -1,111 +1,257 @@
 #include "message_handler.h"
+#include "file_loader.h"
+#include "sharded_provider.h"
+#include "mtrace/latency_histogram.h"
+#include "mtrace/mtrace.h"
+#include "mtrace/malloc_counter.h"
 
-#include <boost/tokenizer.hpp>
-
-#include <iterator>
-#include <fstream>
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <vector>
 
-int mem_allocs = 0;
-
-void* operator new(std::size_t n)
+// single-threaded baseline: the calling thread applies every update itself
+template <typename MarketDataProvider>
+void benchmark_update_throughput(const std::vector<stock>& stocks, const std::vector<std::uint32_t>& sequence)
 {
-    ++mem_allocs;
-    return malloc(n);
+    MarketDataProvider mdp;
+    for (auto&& s : stocks)
+        mdp.add_stock(s);
+    finish_load(mdp, 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < sequence.size(); ++i)
+    {
+        const stock& s = stocks[sequence[i]];
+        mdp.on_price_change(s.market_ref.c_str(), s.market_ref.size(), 10.0 + i % 100);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "update throughput: " << mdp.name() << " --- threads: 1"
+              << " - updates/s: " << static_cast<std::uint64_t>(sequence.size() / seconds) << std::endl;
 }
 
-template <typename StringT, typename Callable>
-void load_file(StringT&& filename, Callable f)
+// `threads` feed threads publish disjoint slices of the sequence to `threads` shard writers;
+// the writers are pinned to the first `threads` CPUs, the feeds to the next ones
+template <typename MarketDataProvider>
+void benchmark_sharded_throughput(const std::vector<stock>& stocks, const std::vector<std::uint32_t>& sequence, std::size_t threads)
 {
-    std::ifstream ifs(filename);
-    boost::char_separator<char> sep(",");
+    sharded_market_data_provider<MarketDataProvider> mdp(threads, threads);
+    for (auto&& s : stocks)
+        mdp.add_stock(s);
+    mdp.start();
+
+    auto start = std::chrono::steady_clock::now();
 
-    for (std::string line; std::getline(ifs, line); )
+    std::vector<std::thread> feeds;
+    for (std::size_t p = 0; p < threads; ++p)
     {
-        boost::tokenizer<boost::char_separator<char>> tok(line, sep);
-        assert(std::distance(tok.begin(), tok.end()) == 3);
+        feeds.emplace_back([&, p]()
+        {
+            pin_to_cpu(threads + p);
+            auto router = mdp.make_router(p);
+            for (std::size_t i = p; i < sequence.size(); i += threads)
+            {
+                const stock& s = stocks[sequence[i]];
+                router.on_price_change(s.market_ref.c_str(), s.market_ref.size(), 10.0 + i % 100);
+            }
+            router.flush();
+        });
+    }
 
-        auto it = tok.begin();
-        ++it; // skip the 1st field
-        std::string ref = *it;
-        ++it;
-        double price = std::stof(*it);
+    for (auto&& feed : feeds)
+        feed.join();
+    mdp.stop();
 
-        f(ref, price);
-    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (mdp.applied() != sequence.size())
+        throw std::runtime_error("sharded provider lost updates");
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "update throughput: " << mdp.name() << " --- threads: " << threads << " feed + " << threads << " shard"
+              << " - updates/s: " << static_cast<std::uint64_t>(sequence.size() / seconds) << std::endl;
 }
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc != 2 && argc != 3)
     {
-        std::cerr << argv[0] << " <filename>" << std::endl;
+        std::cerr << argv[0] << " <filename> [max feed + shard threads]" << std::endl;
         return 1;
     }
 
+    // feed and shard threads all spin: together they never outnumber the cores, except for
+    // the 1 feed + 1 shard run on a single core
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t max_threads = std::min(cores, argc == 3 ? std::stoul(argv[2]) : cores);
+
     std::srand(std::time(NULL));
 
     market_data_provider_mic_string mdp_mic_string;
     market_data_provider_mic_string_view mdp_mic_string_view;
+    market_data_provider_mic_isin mdp_mic_isin;
     market_data_provider_umap_string mdp_umap_string;
     market_data_provider_umap_string_view mdp_umap_string_view;
+    market_data_provider_umap_isin mdp_umap_isin;
+    market_data_provider_swiss_string_view mdp_swiss_string_view;
+    market_data_provider_perfect_hash mdp_perfect_hash;
     std::vector<stock> stocks;
 
+    tsc_chrono::init();
+
     load_file(argv[1], [&](const std::string& ref, double price)
     {
         stocks.emplace_back(ref, ref, price, 100);
     });
 
+    // both loaders only read the records here, so that the time is spent in parsing
+    auto benchmark_load = [&](const char* name, auto&& load)
+    {
+        mtrace<malloc_counter> mt;
+        std::size_t lines = 0;
+        double total = 0.0;
+
+        auto start = std::chrono::steady_clock::now();
+        load([&](auto&& ref, double price)
+        {
+            ++lines;
+            total += price + ref.size();
+        });
+        auto end = std::chrono::steady_clock::now();
+        const malloc_counter allocs = mt.get<0>();
+
+        std::cout << "load: " << name << " --- mem allocs: " << allocs.malloc_calls()
+                  << " - time elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+                  << " - lines: " << lines << " - checksum: " << total << std::endl;
+    };
+
+    benchmark_load("ifstream+tokenizer", [&](auto&& f) { load_file(argv[1], f); });
+    benchmark_load("mmap", [&](auto&& f)
+    {
+        mapped_file file(argv[1]);
+        load_mapped_file(file, f);
+    });
+
+    // the same table filled by both loaders: with a copy of each key in its stock, or keyed
+    // on views into the mapping
+    auto benchmark_load_provider = [&](const char* name, auto&& market_data_provider, auto&& load)
+    {
+        mtrace<malloc_counter> mt;
+
+        auto start = std::chrono::steady_clock::now();
+        load(market_data_provider);
+        auto end = std::chrono::steady_clock::now();
+        const malloc_counter allocs = mt.get<0>();
+
+        std::cout << "load: " << name << " -> " << market_data_provider.name() << " --- mem allocs: " << allocs.malloc_calls()
+                  << " (" << allocs.malloc_bytes() << " bytes)"
+                  << " - time elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << std::endl;
+    };
+
+    market_data_provider_swiss_string_view mdp_swiss_loaded;
+    benchmark_load_provider("ifstream+tokenizer", mdp_swiss_loaded, [&](auto& mdp)
+    {
+        load_file(argv[1], [&](const std::string& ref, double price) { mdp.add_stock(stock(ref, ref, price, 100)); });
+    });
+
+    market_data_provider_mapped_file mdp_mapped_file;
+    benchmark_load_provider("mmap", mdp_mapped_file, [&](auto& mdp) { mdp.load(argv[1]); });
+
+    if (mdp_mapped_file.size() != stocks.size())
+        throw std::runtime_error("unexpected number of mapped stocks: " + std::to_string(mdp_mapped_file.size()));
+
     auto benchmark_insert = [&](auto&& market_data_provider)
     {
-        mem_allocs = 0;
+        mtrace<malloc_counter> mt;
         counter<std::string>::reset();
         counter<std::experimental::string_view>::reset();
 
+        latency_histogram latencies;
         auto start = std::chrono::steady_clock::now();
 
-        for (auto&& stock : stocks)
-            market_data_provider.add_stock(stock);
+        auto it = stocks.begin();
+        const std::chrono::nanoseconds timing = record_latencies(latencies, stocks.size(), [&]() { market_data_provider.add_stock(*it++); });
+        finish_load(market_data_provider, 0);
 
-        auto end = std::chrono::steady_clock::now();
-        std::cout << "insert: " << market_data_provider.name() << " --- mem allocs: " << mem_allocs
+        auto end = std::chrono::steady_clock::now() - timing;
+        const malloc_counter allocs = mt.get<0>();
+        std::cout << "insert: " << market_data_provider.name() << " --- mem allocs: " << allocs.malloc_calls() << " (" << allocs.malloc_bytes() << " bytes)"
                   << " - time elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " - "
-                  << counter<std::string>() << " - " << counter<std::string>() << std::endl;
+                  << counter<std::string>() << " - " << counter<std::string>() << std::endl
+                  << "insert: " << market_data_provider.name() << " --- add_stock " << latencies << std::endl;
     };
 
     auto benchmark_lookup = [&](auto&& market_data_provider)
     {
-        mem_allocs = 0;
         counter<std::string>::reset();
         counter<std::experimental::string_view>::reset();
 
+        static const int Iterations = 1e4;
+
+        // the random picks happen outside of the timed calls
+        std::vector<const stock*> picks(Iterations);
+        for (auto& p : picks)
+            p = &stocks[std::rand() % stocks.size()];
+
+        mtrace<malloc_counter> mt;
+        latency_histogram latencies;
         auto start = std::chrono::steady_clock::now();
 
-        static const int Iterations = 1e4;
-        for (int i = 0; i < Iterations; ++i)
+        auto it = picks.begin();
+        const std::chrono::nanoseconds timing = record_latencies(latencies, Iterations, [&]()
         {
-            const stock& s = stocks[std::rand() % stocks.size()];
+            const stock& s = **it++;
             market_data_provider.on_price_change(s.market_ref.c_str(), s.market_ref.size(), 10.0);
-        }
+        });
 
-        auto end = std::chrono::steady_clock::now();
-        std::cout << "lookup: " << market_data_provider.name() << " --- mem allocs: " << mem_allocs
+        auto end = std::chrono::steady_clock::now() - timing;
+        const malloc_counter allocs = mt.get<0>();
+        std::cout << "lookup: " << market_data_provider.name() << " --- mem allocs: " << allocs.malloc_calls()
                   << " - time elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " - "
-                  << counter<std::string>() << " - " << counter<std::string>() << std::endl;
+                  << counter<std::string>() << " - " << counter<std::string>() << std::endl
+                  << "lookup: " << market_data_provider.name() << " --- on_price_change " << latencies << std::endl;
     };
 
     benchmark_insert(mdp_mic_string);
     benchmark_insert(mdp_mic_string_view);
+    benchmark_insert(mdp_mic_isin);
     benchmark_insert(mdp_umap_string);
     benchmark_insert(mdp_umap_string_view);
+    benchmark_insert(mdp_umap_isin);
+    benchmark_insert(mdp_swiss_string_view);
+    benchmark_insert(mdp_perfect_hash);
 
     benchmark_lookup(mdp_mic_string);
     benchmark_lookup(mdp_mic_string_view);
+    benchmark_lookup(mdp_mic_isin);
     benchmark_lookup(mdp_umap_string);
     benchmark_lookup(mdp_umap_string_view);
+    benchmark_lookup(mdp_umap_isin);
+    benchmark_lookup(mdp_swiss_string_view);
+    benchmark_lookup(mdp_perfect_hash);
+    benchmark_lookup(mdp_mapped_file);
+
+    std::vector<std::uint32_t> sequence(1000000);
+    for (auto& i : sequence)
+        i = std::rand() % stocks.size();
+
+    benchmark_update_throughput<market_data_provider_mic_string_view>(stocks, sequence);
+    benchmark_update_throughput<market_data_provider_umap_string_view>(stocks, sequence);
+
+    // powers of two feeds and shards, then as many as fit in max_threads when it is not one
+    const std::size_t top_threads = std::max<std::size_t>(1, max_threads / 2);
+    for (std::size_t threads = 1; threads <= top_threads; threads = threads < top_threads ? std::min(2 * threads, top_threads) : threads + 1)
+    {
+        benchmark_sharded_throughput<market_data_provider_mic_string_view>(stocks, sequence, threads);
+        benchmark_sharded_throughput<market_data_provider_umap_string_view>(stocks, sequence, threads);
+    }
 
     return 0;
 }
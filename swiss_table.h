@@ -0,0 +1,192 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Open-addressing hash table in the style of Abseil's SwissTable: elements are stored inline
+// in a flat slot array, and a parallel array of one control byte per slot holds either
+// Empty or the low 7 bits of the element hash. A lookup loads a group of 16 control bytes
+// with one SSE2 load, compares them against the hash tag in parallel, and only touches the
+// slots whose tag matches; an Empty byte in the group ends the probe sequence.
+//
+// Insert-only: there is no erase, hence no tombstones. Elements move on rehash.
+template <typename Value, typename KeyFromValue, typename Hash, typename KeyEqual = std::equal_to<typename KeyFromValue::result_type>>
+class swiss_table
+{
+    static_assert(alignof(Value) <= alignof(std::max_align_t), "over-aligned values are not supported");
+
+public:
+    using key_type = typename KeyFromValue::result_type;
+    using value_type = Value;
+
+    static const std::size_t GroupSize = 16;
+
+    swiss_table() =default;
+
+    ~swiss_table()
+    {
+        destroy();
+    }
+
+    swiss_table(const swiss_table&) =delete;
+    swiss_table& operator=(const swiss_table&) =delete;
+
+    std::size_t size() const { return _size; }
+    std::size_t capacity() const { return _groups * GroupSize; }
+    bool empty() const { return _size == 0; }
+
+    void reserve(std::size_t n)
+    {
+        std::size_t groups = 1;
+        while (groups * GroupSize * MaxLoadNum / MaxLoadDen < n)
+            groups *= 2;
+
+        if (groups > _groups)
+            rehash(groups);
+    }
+
+    Value* find(const key_type& k)
+    {
+        return const_cast<Value*>(static_cast<const swiss_table&>(*this).find(k));
+    }
+
+    const Value* find(const key_type& k) const
+    {
+        if (_size == 0)
+            return nullptr;
+
+        const std::size_t h = _hash(k);
+        const __m128i tag = _mm_set1_epi8(static_cast<char>(h2(h)));
+
+        std::size_t g = h1(h) & (_groups - 1);
+        for (std::size_t step = 1; ; ++step)
+        {
+            const __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(_ctrl + g * GroupSize));
+
+            for (unsigned match = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, tag)); match; match &= match - 1)
+            {
+                const Value& v = _slots[g * GroupSize + __builtin_ctz(match)];
+                if (_eq(_key(v), k))
+                    return &v;
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(Empty))))
+                return nullptr;
+
+            g = (g + step) & (_groups - 1); // triangular probing visits every group
+        }
+    }
+
+    template <typename... Args>
+    std::pair<Value*, bool> emplace(Args&&... args)
+    {
+        if ((_size + 1) * MaxLoadDen > capacity() * MaxLoadNum)
+            rehash(_groups ? _groups * 2 : 1);
+
+        Value v(std::forward<Args>(args)...);
+        if (Value* existing = find(_key(v)))
+            return {existing, false};
+
+        const std::size_t h = _hash(_key(v));
+        Value* slot = new (_slots + claim_slot(h)) Value(std::move(v));
+        ++_size;
+        return {slot, true};
+    }
+
+    std::pair<Value*, bool> insert(const Value& v) { return emplace(v); }
+    std::pair<Value*, bool> insert(Value&& v) { return emplace(std::move(v)); }
+
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (std::size_t i = 0; i < capacity(); ++i)
+            if (_ctrl[i] != Empty)
+                f(_slots[i]);
+    }
+
+private:
+    enum : std::int8_t { Empty = -128 };
+
+    static const std::size_t MaxLoadNum = 7;
+    static const std::size_t MaxLoadDen = 8;
+
+    static std::size_t h1(std::size_t h) { return h >> 7; }
+    static std::int8_t h2(std::size_t h) { return static_cast<std::int8_t>(h & 0x7f); }
+
+    // marks the first empty slot of h's probe sequence as full and returns its index
+    std::size_t claim_slot(std::size_t h)
+    {
+        std::size_t g = h1(h) & (_groups - 1);
+        for (std::size_t step = 1; ; ++step)
+        {
+            const __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(_ctrl + g * GroupSize));
+            const unsigned empty = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(Empty)));
+            if (empty)
+            {
+                const std::size_t i = g * GroupSize + __builtin_ctz(empty);
+                _ctrl[i] = h2(h);
+                return i;
+            }
+
+            g = (g + step) & (_groups - 1);
+        }
+    }
+
+    void rehash(std::size_t groups)
+    {
+        std::int8_t* old_ctrl = _ctrl;
+        Value* old_slots = _slots;
+        const std::size_t old_capacity = capacity();
+
+        _groups = groups;
+        _ctrl = reinterpret_cast<std::int8_t*>(new __m128i[groups]);
+        _slots = static_cast<Value*>(::operator new(capacity() * sizeof(Value)));
+        std::fill(_ctrl, _ctrl + capacity(), Empty);
+
+        for (std::size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old_ctrl[i] == Empty)
+                continue;
+
+            Value& v = old_slots[i];
+            new (_slots + claim_slot(_hash(_key(v)))) Value(std::move(v));
+            v.~Value();
+        }
+
+        release(old_ctrl, old_slots);
+    }
+
+    void destroy()
+    {
+        for (std::size_t i = 0; i < capacity(); ++i)
+            if (_ctrl[i] != Empty)
+                _slots[i].~Value();
+
+        release(_ctrl, _slots);
+    }
+
+    static void release(std::int8_t* ctrl, Value* slots)
+    {
+        if (!ctrl)
+            return;
+
+        delete[] reinterpret_cast<__m128i*>(ctrl);
+        ::operator delete(slots);
+    }
+
+    std::int8_t* _ctrl = {};
+    Value* _slots = {};
+    std::size_t _groups = {};
+    std::size_t _size = {};
+
+    KeyFromValue _key;
+    Hash _hash;
+    KeyEqual _eq;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// One price update as decoded by the feed handler: 32 bytes, two ticks per cache line.
+struct tick
+{
+    static const std::size_t MaxMarketRefSize = 14;
+
+    tick() =default;
+
+    tick(const char* ref, std::size_t ref_len, double _price) :
+        price(_price),
+        len(static_cast<std::uint8_t>(ref_len))
+    {
+        if (ref_len > MaxMarketRefSize)
+            throw std::length_error("market reference " + std::string(ref, ref_len) + " too long for a tick");
+
+        std::memset(market_ref, 0, sizeof(market_ref));
+        std::memcpy(market_ref, ref, ref_len);
+    }
+
+    std::uint64_t timestamp = {}; // rdtsc when the tick was published
+    double price = {};
+    char market_ref[15] = {};     // zero-padded, hence null-terminated
+    std::uint8_t len = {};
+};
+
+static_assert(sizeof(tick) == 32, "unexpected tick layout");
@@ -0,0 +1,147 @@
+#include "message_handler.h"
+#include "file_loader.h"
+#include "spsc_queue.h"
+#include "tick.h"
+#include "mtrace/tsc_chrono.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const std::size_t QueueCapacity = 1 << 12;
+static const std::size_t BatchSize = 16;
+
+using tick_queue = spsc_queue<tick, QueueCapacity>;
+
+// The calling thread plays the feed handler and publishes `ticks` price updates in batches;
+// a strategy thread consumes them and applies them to the market data provider.
+template <typename MarketDataProvider>
+void benchmark_feed(const std::vector<stock>& stocks, const std::vector<std::uint32_t>& sequence)
+{
+    MarketDataProvider mdp;
+    for (auto&& s : stocks)
+        mdp.add_stock(s);
+    finish_load(mdp, 0);
+
+    auto queue = std::make_unique<tick_queue>();
+    std::atomic<bool> done{false};
+
+    std::uint64_t total_latency = 0;
+    std::uint64_t max_latency = 0;
+    std::size_t applied = 0;
+
+    std::thread strategy([&]()
+    {
+        tick batch[BatchSize];
+        for (;;)
+        {
+            const std::size_t n = queue->try_pop(batch, BatchSize);
+            if (n == 0)
+            {
+                if (done.load(std::memory_order_acquire) && queue->size() == 0)
+                    break;
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                const tick& t = batch[i];
+                mdp.on_price_change(t.market_ref, t.len, t.price);
+
+                const std::uint64_t latency = detail::rdtsc() - t.timestamp;
+                total_latency += latency;
+                max_latency = std::max(max_latency, latency);
+            }
+            applied += n;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+
+    tick batch[BatchSize] = {};
+    for (std::size_t i = 0; i < sequence.size(); )
+    {
+        const std::size_t n = std::min(BatchSize, sequence.size() - i);
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            const stock& s = stocks[sequence[i + j]];
+            batch[j] = tick(s.market_ref.data(), s.market_ref.size(), 10.0 + (i + j) % 100);
+        }
+
+        // spin until the whole batch is in, timestamps are taken just before publishing
+        for (std::size_t pushed = 0; pushed < n; )
+        {
+            const std::uint64_t now = detail::rdtsc();
+            for (std::size_t j = pushed; j < n; ++j)
+                batch[j].timestamp = now;
+
+            const std::size_t k = queue->try_push(batch + pushed, batch + n);
+            if (k == 0)
+                std::this_thread::yield();
+            pushed += k;
+        }
+
+        i += n;
+    }
+
+    done.store(true, std::memory_order_release);
+    strategy.join();
+
+    auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "feed: " << mdp.name() << " --- ticks: " << applied
+              << " - ticks/s: " << static_cast<std::uint64_t>(applied / seconds)
+              << " - latency avg: " << tsc_chrono::from_cycles(total_latency / std::max<std::size_t>(applied, 1)).count() << "ns"
+              << " max: " << tsc_chrono::from_cycles(max_latency).count() << "ns" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << argv[0] << " <filename> [ticks]" << std::endl;
+        return 1;
+    }
+
+    const std::size_t ticks = argc == 3 ? std::stoul(argv[2]) : 1000000;
+
+    std::vector<stock> stocks;
+    load_file(argv[1], [&](const std::string& ref, double price)
+    {
+        if (ref.size() > tick::MaxMarketRefSize)
+            throw std::runtime_error("market reference " + ref + " too long for a tick");
+
+        stocks.emplace_back(ref, ref, price, 100);
+    });
+
+    if (stocks.empty())
+        throw std::runtime_error("no stock loaded");
+
+    // the same random sequence of stocks for every provider
+    std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<std::uint32_t> rng(0, stocks.size() - 1);
+    std::vector<std::uint32_t> sequence(ticks);
+    for (auto& i : sequence)
+        i = rng(gen);
+
+    tsc_chrono::init();
+
+    benchmark_feed<market_data_provider_mic_string>(stocks, sequence);
+    benchmark_feed<market_data_provider_mic_string_view>(stocks, sequence);
+    benchmark_feed<market_data_provider_mic_isin>(stocks, sequence);
+    benchmark_feed<market_data_provider_umap_string>(stocks, sequence);
+    benchmark_feed<market_data_provider_umap_string_view>(stocks, sequence);
+    benchmark_feed<market_data_provider_umap_isin>(stocks, sequence);
+    benchmark_feed<market_data_provider_swiss_string_view>(stocks, sequence);
+    benchmark_feed<market_data_provider_perfect_hash>(stocks, sequence);
+
+    return 0;
+}
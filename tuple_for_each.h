@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+namespace detail
+{
+    template<typename T, typename F, std::size_t... Is>
+    void for_each(T&& t, F f, std::integer_sequence<std::size_t, Is...>)
+    {
+        auto l = { (f(std::get<Is>(t)), 0)... };
+        (void)l;
+    }
+
+    // calls f on every element of t in order, e.g. on every index of a container
+    template<typename Tuple, typename F>
+    void for_each_in_tuple(Tuple& t, F f)
+    {
+        detail::for_each(t, f, std::make_index_sequence<std::tuple_size<Tuple>::value>{});
+    }
+}